@@ -0,0 +1,91 @@
+#ifndef __ABR_CUSTOM_DISPATCH_H__
+#define __ABR_CUSTOM_DISPATCH_H__
+
+#include "custom_kernels.h"
+#include "custom_cmsis_kernels.h"
+
+// Kernel implementations that can be selected for each op.
+//
+// The CMSIS kernels use the Cortex-M4 SIMD (DSP extension) instructions when
+// built for the pod with ARM_MATH_DSP, and fall back to the portable CMSIS C
+// code on the host. All implementations are bit-exact with the reference.
+enum KernelImpl {
+  kKernelReference = 0,
+  kKernelCmsis = 1,
+};
+
+constexpr int kNumKernelImpls = 2;
+
+inline const char* KernelImplName(KernelImpl impl) {
+  return (impl == kKernelCmsis) ? "cmsis" : "reference";
+}
+
+inline const char* KernelImplConstant(KernelImpl impl) {
+  return (impl == kKernelCmsis) ? "kKernelCmsis" : "kKernelReference";
+}
+
+inline void DispatchFullyConnected(
+    KernelImpl impl,
+    const FullyConnectedParams& params,
+    const CMSISFullyConnectedParams& cmsis_params,
+    const RuntimeShape& input_shape, const int8_t* input_data,
+    const RuntimeShape& filter_shape, const int8_t* filter_data,
+    const RuntimeShape& bias_shape, const int32_t* bias_data,
+    const RuntimeShape& output_shape, int8_t* output_data
+) {
+  if (impl == kKernelCmsis) {
+    CMSIS_FullyConnected(cmsis_params, input_shape, input_data, filter_shape,
+                         filter_data, bias_shape, bias_data, output_shape,
+                         output_data);
+  } else {
+    FullyConnected(params, input_shape, input_data, filter_shape, filter_data,
+                   bias_shape, bias_data, output_shape, output_data);
+  }
+}
+
+inline void DispatchAdd(
+    KernelImpl impl,
+    const ArithmeticParams& params,
+    const RuntimeShape& input1_shape, const int8_t* input1_data,
+    const RuntimeShape& input2_shape, const int8_t* input2_data,
+    const RuntimeShape& output_shape, int8_t* output_data
+) {
+  if (impl == kKernelCmsis) {
+    CMSIS_Add(params, input1_shape, input1_data, input2_shape, input2_data,
+              output_shape, output_data);
+  } else {
+    Add(params, input1_shape, input1_data, input2_shape, input2_data,
+        output_shape, output_data);
+  }
+}
+
+/* ****************************************************************************
+ * Kernel tuner.
+ *
+ * The tuner runs every op of a model with every kernel implementation, checks
+ * that the output is bit-exact with the reference kernel and times the op. It
+ * then prints a ``dispatch_<model>.h`` header to stdout selecting the fastest
+ * bit-exact kernel for each op. Run it on the target the table is meant for.
+ */
+
+// Monotonic tick counter used to time ops (e.g. the DWT cycle counter on the
+// pod, or a microsecond clock on the host). Only differences are used, so the
+// counter may wrap.
+typedef uint32_t (*TunerClock)();
+
+// Runs a single op of the model with the given kernel implementation.
+typedef void (*TunerRunOp)(int op, KernelImpl impl);
+
+struct TunerOp {
+  int op;                // op index in the model graph
+  const char* name;      // op type, for the generated comments
+  const int8_t* output;  // output buffer written by the op
+  int output_size;       // number of output elements
+};
+
+// ``ops`` must be listed in execution order and the model inputs/states must
+// already be set, so that every op sees realistic data. Returns 0 on success.
+int TuneKernels(const char* model_name, const TunerOp* ops, int num_ops,
+                TunerRunOp run_op, TunerClock clock, int iterations);
+
+#endif  // __ABR_CUSTOM_DISPATCH_H__
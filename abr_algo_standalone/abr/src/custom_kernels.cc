@@ -110,6 +110,71 @@ void FullyConnected(
   }
 }
 
+void OuterProductAdd(
+    const FullyConnectedParams& fc_params, const ArithmeticParams& add_params,
+    const RuntimeShape& input_shape, const int8_t* input_data,
+    const RuntimeShape& filter_shape, const int8_t* filter_data,
+    const RuntimeShape& addend_shape, const int8_t* addend_data,
+    const RuntimeShape& output_shape, int8_t* output_data
+) {
+#ifndef NDEBUG
+  CheckArithmeticParams(add_params);
+#endif
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 2);
+  const int rows = output_shape.Dims(0);
+  const int cols = output_shape.Dims(1);
+  TFLITE_DCHECK_EQ(input_shape.FlatSize(), rows);
+  TFLITE_DCHECK_EQ(filter_shape.FlatSize(), cols);
+  TFLITE_DCHECK_EQ(addend_shape.FlatSize(), rows * cols);
+
+  // A multiplier of 0.5 with no shift is exact: the doubling high multiply by
+  // 1 << 30 halves the (even) shifted value and never needs rounding.
+  const bool addend_halved = add_params.input1_multiplier == (1 << 30) &&
+                             add_params.input1_shift == 0 &&
+                             add_params.left_shift >= 1;
+  const int addend_shift =
+      addend_halved ? add_params.left_shift - 1 : add_params.left_shift;
+
+  for (int r = 0; r < rows; ++r) {
+    const int32_t input_val = input_data[r] + fc_params.input_offset;
+    for (int c = 0; c < cols; ++c) {
+      const int i = r * cols + c;
+
+      // Outer product, requantized to int8 as FullyConnected() does
+      const int32_t filter_val = filter_data[c] + fc_params.weights_offset;
+      int32_t acc = MultiplyByQuantizedMultiplier(
+          filter_val * input_val, fc_params.output_multiplier,
+          fc_params.output_shift);
+      acc += fc_params.output_offset;
+      acc = std::max(acc, fc_params.quantized_activation_min);
+      acc = std::min(acc, fc_params.quantized_activation_max);
+
+      // Add, with the product as the second input
+      const int32_t input1_val = add_params.input1_offset + addend_data[i];
+      const int32_t input2_val = add_params.input2_offset + acc;
+      const int32_t scaled_input1_val =
+          addend_halved
+              ? input1_val * (1 << addend_shift)
+              : MultiplyByQuantizedMultiplierSmallerThanOneExp(
+                    input1_val * (1 << addend_shift),
+                    add_params.input1_multiplier, add_params.input1_shift);
+      const int32_t scaled_input2_val =
+          MultiplyByQuantizedMultiplierSmallerThanOneExp(
+              input2_val * (1 << add_params.left_shift),
+              add_params.input2_multiplier, add_params.input2_shift);
+      const int32_t raw_sum = scaled_input1_val + scaled_input2_val;
+      const int32_t raw_output =
+          MultiplyByQuantizedMultiplierSmallerThanOneExp(
+              raw_sum, add_params.output_multiplier, add_params.output_shift) +
+          add_params.output_offset;
+      const int32_t clamped_output =
+          std::min(add_params.quantized_activation_max,
+                   std::max(add_params.quantized_activation_min, raw_output));
+      output_data[i] = static_cast<int8_t>(clamped_output);
+    }
+  }
+}
+
 void Requantize(const int8_t* input_data, int32_t size,
                        int32_t effective_scale_multiplier,
                        int32_t effective_scale_shift, int32_t input_zeropoint,
@@ -3,11 +3,16 @@
 #include "constants.h"
 #include "custom_kernels.h"
 #include "custom_cmsis_kernels.h"
+#include "custom_float_kernels.h"
+#include "custom_dispatch.h"
+#include "dispatch_waist.h"
+#include "arena_waist.h"
 
 namespace {
 
   const float input0_scale = 1.83163956e-03;
   const int32_t input0_zero_point = 14;
+  const float input0_inv_scale = 1.0f / input0_scale;
   const float input1_scale = 7.29666231e-03;
   const int32_t input1_zero_point = 7;
   const float output0_scale = 6.58982471e-02;
@@ -87,8 +92,30 @@ namespace {
   int8_t output0[kOutputSize];
   int8_t output1[kStateInputSize];
 
-  int8_t buffer_a[18];
-  int8_t buffer_b[18];
+  // Intermediate activations, laid out by plan_arena.py (see arena_waist.h)
+  int8_t arena[kWaistArenaSize];
+  int8_t* const op0_output = arena + kWaistOp0Output;
+  int8_t* const op1_output = arena + kWaistOp1Output;
+  int8_t* const op5_output = arena + kWaistOp5Output;
+  int8_t* const op8_output = arena + kWaistOp8Output;
+
+  // Scales of the intermediate activations, for the float reference
+  const float op0_output_scale = 3.44231026e-03;
+  const int32_t op0_output_zero_point = -128;
+  const float op1_output_scale = 1.10950582e-02;
+  const int32_t op1_output_zero_point = -17;
+  const float op5_output_scale = 7.22068641e-03;
+  const int32_t op5_output_zero_point = 5;
+  const float op8_output_scale = 3.20607075e-03;
+  const int32_t op8_output_zero_point = -128;
+
+  // Float reference params: dequantization scales of the weights and biases
+  const FloatFullyConnectedParams float_params_0 = {2.44739223e-02, 4.48274041e-05, true};
+  const FloatFullyConnectedParams float_params_1 = {2.20677685e-02, 0.0f, false};
+  const FloatFullyConnectedParams float_params_3 = {1.20992493e-03, 0.0f, false};
+  const FloatFullyConnectedParams float_params_5 = {7.71084474e-03, 0.0f, false};
+  const FloatFullyConnectedParams float_params_8 = {7.56095257e-03, 5.79496773e-05, true};
+  const FloatFullyConnectedParams float_params_9 = {6.13191836e-02, 1.96593639e-04, false};
 
   // arm_fully_connected_s8_get_buffer_size currently always returns 0
   // we could get rid of this completely, but things run a hair quicker with it
@@ -106,6 +133,17 @@ inline int8_t clip_int8(int32_t val) {
   return static_cast<int8_t>(std::max(lower, std::min(val, upper)));
 }
 
+// Quantizes an already scaled value to int8 without a division or a libm call.
+// Rounds half away from zero like round(): adding the largest float below 0.5
+// keeps values just below a half from rounding up. The value is clamped first
+// so that the conversion cannot overflow.
+inline int8_t quantize_int8(float scaled_val, int32_t zero_point) {
+  scaled_val = std::max(-256.0f, std::min(scaled_val, 256.0f));
+  const int32_t rounded = static_cast<int32_t>(
+      scaled_val + std::copysign(0.49999997f, scaled_val));
+  return clip_int8(rounded + zero_point);
+}
+
 int custom_waist_setup(int input_size, int state_size, int output_size) {
   if (input_size != kModelInputSize) {
     printf("Input size %d does not match library %d. Check constants.h\n\r",
@@ -199,7 +237,6 @@ int custom_waist_setup(int input_size, int state_size, int output_size) {
   op_params_9.quantized_activation_min = -128;
   op_params_9.quantized_activation_max = 127;
 
-// #ifdef CMSIS_FC
   CMSIS_FillFCParams(
       op_params_0c, op_params_0, input_shape_0, filter_shape_0,
       bias_shape_0, output_shape_0, scratch_size, scratch);
@@ -218,7 +255,6 @@ int custom_waist_setup(int input_size, int state_size, int output_size) {
   CMSIS_FillFCParams(
       op_params_9c, op_params_9, input_shape_9, filter_shape_9,
       bias_shape_9, output_shape_9, scratch_size, scratch);
-// #endif
 
   return 0;
 }
@@ -239,18 +275,106 @@ void custom_waist_get_states(float * state_vals) {
 
 void custom_waist_set_inputs(float * input_vals) {
   for (int i = 0; i < kModelInputSize; i++) {
-    input0[i] = clip_int8(
-        round_int32(input_vals[i] / input0_scale) + input0_zero_point
-    );
+    input0[i] = quantize_int8(input_vals[i] * input0_inv_scale,
+                              input0_zero_point);
+  }
+}
+
+void custom_waist_set_scaled_inputs(const float * scaled_vals) {
+  for (int i = 0; i < kModelInputSize; i++) {
+    input0[i] = quantize_int8(scaled_vals[i], input0_zero_point);
   }
 }
 
+float custom_waist_get_input_inv_scale() {
+  return input0_inv_scale;
+}
+
 void custom_waist_get_outputs(float * output_vals) {
   for (int i = 0; i < kOutputSize; i++) {
     output_vals[i] = (output0[i] - output0_zero_point) * output0_scale;
   }
 }
 
+// Runs a single op of the model with the given kernel implementation. The
+// kernel is a compile-time constant for inference, so the dispatch is free.
+static inline void waist_run_op(int op, KernelImpl impl) {
+  switch (op) {
+    case 0:
+      DispatchFullyConnected(
+          impl, op_params_0, op_params_0c,
+          input_shape_0, input0,  // input
+          filter_shape_0, filter_0_data,
+          bias_shape_0, bias_0_data,
+          output_shape_0, op0_output  // output
+      );
+      break;
+    case 1:
+      DispatchFullyConnected(
+          impl, op_params_1, op_params_1c,
+          input_shape_1, op0_output,  // input
+          filter_shape_1, filter_1_data,
+          bias_shape_1, bias_1_data,
+          output_shape_1, op1_output  // output
+      );
+      break;
+    case 3:
+      // Ops 3 and 6 (outer product and add), writing output1 directly. The
+      // CMSIS kernels have no fused op, so they run the pair in place.
+      if (impl == kKernelCmsis) {
+        CMSIS_FullyConnected(
+            op_params_3c,
+            input_shape_3, op1_output,  // input
+            filter_shape_3, filter_3_data,
+            bias_shape_3, bias_3_data,
+            output_shape_3, output1  // output
+        );
+        CMSIS_Add(
+            op_params_6,
+            input1_shape_6, op5_output,  // input
+            input2_shape_6, output1,  // input
+            output_shape_6, output1  // output
+        );
+      } else {
+        OuterProductAdd(
+            op_params_3, op_params_6,
+            input_shape_3, op1_output,  // input
+            filter_shape_3, filter_3_data,
+            input1_shape_6, op5_output,  // input
+            output_shape_6, output1  // output
+        );
+      }
+      break;
+    case 5:
+      DispatchFullyConnected(
+          impl, op_params_5, op_params_5c,
+          input_shape_5, input1,  // input
+          filter_shape_5, filter_5_data,
+          bias_shape_5, bias_5_data,
+          output_shape_5, op5_output  // output
+      );
+      break;
+    case 8:
+      DispatchFullyConnected(
+          impl, op_params_8, op_params_8c,
+          input_shape_8, output1,  // input
+          filter_shape_8, filter_8_data,
+          bias_shape_8, bias_8_data,
+          output_shape_8, op8_output  // output
+      );
+      break;
+    case 9:
+      DispatchFullyConnected(
+          impl, op_params_9, op_params_9c,
+          input_shape_9, op8_output,  // input
+          filter_shape_9, filter_9_data,
+          bias_shape_9, bias_9_data,
+          output_shape_9, output0  // output
+      );
+      break;
+  }
+}
+
 int custom_waist_inference() {
   //--- Op 0: FULLY_CONNECTED
   //--- Op 1: FULLY_CONNECTED
@@ -266,220 +390,164 @@ int custom_waist_inference() {
   // op6 -> op7 -> op8 -> op9 -> output0
   //            -> output1
 
-  // Buffer usage:
-  // op0(input0) -> buffer_a
-  // op1(buffer_a) -> buffer_b
-  // op2(buffer_b) -> buffer_b  (reshape no-op)
-  // op3(buffer_b) -> buffer_a
+  // Buffer usage (op outputs are placed in the arena by plan_arena.py):
+  // op0(input0) -> op0_output
+  // op1(op0_output) -> op1_output
+  // op2(op1_output) -> op1_output  (reshape no-op)
   // op4(input1) -> input1  (reshape no-op)
-  // op5(input1) -> buffer_b
-  // op6(buffer_b, buffer_a) -> output1
+  // op5(input1) -> op5_output
+  // op3+op6(op1_output, op5_output) -> output1  (fused outer product and add)
   // op7(output1) -> output1 (reshape no-op)
-  // op8(output1) -> buffer_a
-  // op9(buffer_a) -> output0
-
-  // --- Op 0: FULLY_CONNECTED
-#ifdef CMSIS_FC
-  CMSIS_FullyConnected(
-      op_params_0c,
-      input_shape_0,
-      input0,  // input
-      filter_shape_0,
-      filter_0_data,
-      bias_shape_0,
-      bias_0_data,
-      output_shape_0,
-      buffer_a  // output
-  );
-#else
-  FullyConnected(
-      op_params_0,
-      input_shape_0,
-      input0,  // input
-      filter_shape_0,
-      filter_0_data,
-      bias_shape_0,
-      bias_0_data,
-      output_shape_0,
-      buffer_a  // output
-  );
-#endif
-
-  // printf("Op0:\n");
-  // print_array(output_shape_0, buffer_a);
-  // printf("\n");
-
-  // --- Op 1: FULLY_CONNECTED
-#ifdef CMSIS_FC_EXTRA
-  CMSIS_FullyConnected(
-      op_params_1c,
-      input_shape_1,
-      buffer_a,  // input
-      filter_shape_1,
-      filter_1_data,
-      bias_shape_1,
-      bias_1_data,
-      output_shape_1,
-      buffer_b  // output
-  );
-#else
-  FullyConnected(
-      op_params_1,
-      input_shape_1,
-      buffer_a,  // input
-      filter_shape_1,
-      filter_1_data,
-      bias_shape_1,
-      bias_1_data,
-      output_shape_1,
-      buffer_b  // output
-  );
-#endif
-
-  // printf("Op1:\n");
-  // print_array(output_shape_1, buffer_b);
-  // printf("\n");
-
-  // --- Op 3: FULLY_CONNECTED
-#ifdef CMSIS_FC_EXTRA
-  CMSIS_FullyConnected(
-      op_params_3c,
-      input_shape_3,
-      buffer_b,  // input
-      filter_shape_3,
-      filter_3_data,
-      bias_shape_3,
-      bias_3_data,
-      output_shape_3,
-      buffer_a  // output
-  );
-#else
-  FullyConnected(
-      op_params_3,
-      input_shape_3,
-      buffer_b,  // input
-      filter_shape_3,
-      filter_3_data,
-      bias_shape_3,
-      bias_3_data,
-      output_shape_3,
-      buffer_a  // output
-  );
-#endif
+  // op8(output1) -> op8_output
+  // op9(op8_output) -> output0
 
-  //--- Op 5: FULLY_CONNECTED
-#ifdef CMSIS_FC_EXTRA
-  CMSIS_FullyConnected(
-      op_params_5c,
-      input_shape_5,
-      input1,  // input
-      filter_shape_5,
-      filter_5_data,
-      bias_shape_5,
-      bias_5_data,
-      output_shape_5,
-      buffer_b  // output
-  );
-#else
-  FullyConnected(
-      op_params_5,
-      input_shape_5,
-      input1,  // input
-      filter_shape_5,
-      filter_5_data,
-      bias_shape_5,
-      bias_5_data,
-      output_shape_5,
-      buffer_b  // output
-  );
-#endif
-
-  // printf("Op5:\n");
-  // print_array(input_shape_5, input1);
-  // printf("\n");
-  // print_array(output_shape_5, buffer_b);
-  // printf("\n");
+  // Kernels are selected per op by the tuned table in dispatch_waist.h
+  waist_run_op(0, kWaistOp0Kernel);
+  waist_run_op(1, kWaistOp1Kernel);
+  waist_run_op(5, kWaistOp5Kernel);
+  waist_run_op(3, kWaistOp3Kernel);  // also runs op 6
+  waist_run_op(8, kWaistOp8Kernel);
+  waist_run_op(9, kWaistOp9Kernel);
 
-  //--- Op 6: ADD
-#ifdef CMSIS_ADD
-  CMSIS_Add(
-      op_params_6,
-      input1_shape_6,
-      buffer_b,  // input
-      input2_shape_6,
-      buffer_a,  // input
-      output_shape_6,
-      output1  // output
-  );
-#else
-  Add(
-      op_params_6,
-      input1_shape_6,
-      buffer_b,  // input
-      input2_shape_6,
-      buffer_a,  // input
-      output_shape_6,
-      output1  // output
-  );
-#endif
-
-  // printf("Op6:\n");
-  // print_array(output_shape_6, output1);
-  // printf("\n");
+  return 0;
+}
 
-  //--- Op 8: FULLY_CONNECTED
-#ifdef CMSIS_FC
-  CMSIS_FullyConnected(
-      op_params_8c,
-      input_shape_8,
-      output1,  // input
-      filter_shape_8,
-      filter_8_data,
-      bias_shape_8,
-      bias_8_data,
-      output_shape_8,
-      buffer_a  // output
-  );
-#else
-  FullyConnected(
-      op_params_8,
-      input_shape_8,
-      output1,  // input
-      filter_shape_8,
-      filter_8_data,
-      bias_shape_8,
-      bias_8_data,
-      output_shape_8,
-      buffer_a  // output
-  );
-#endif
+int custom_waist_tune(uint32_t (*clock)(), int iterations) {
+  // Ops in execution order, with the buffer each one writes
+  const TunerOp ops[] = {
+      {0, "FULLY_CONNECTED", op0_output, output_shape_0.FlatSize()},
+      {1, "FULLY_CONNECTED", op1_output, output_shape_1.FlatSize()},
+      {5, "FULLY_CONNECTED", op5_output, output_shape_5.FlatSize()},
+      {3, "FULLY_CONNECTED + ADD (op 6)", output1, output_shape_6.FlatSize()},
+      {8, "FULLY_CONNECTED", op8_output, output_shape_8.FlatSize()},
+      {9, "FULLY_CONNECTED", output0, output_shape_9.FlatSize()},
+  };
+
+  return TuneKernels("waist", ops, sizeof(ops) / sizeof(ops[0]), waist_run_op,
+                     clock, iterations);
+}
 
-  //--- Op 9: FULLY_CONNECTED
-#ifdef CMSIS_FC_EXTRA
-  CMSIS_FullyConnected(
-      op_params_9c,
-      input_shape_9,
-      buffer_a,  // input
-      filter_shape_9,
-      filter_9_data,
-      bias_shape_9,
-      bias_9_data,
-      output_shape_9,
-      output0  // output
-  );
-#else
-  FullyConnected(
-      op_params_9,
-      input_shape_9,
-      buffer_a,  // input
-      filter_shape_9,
-      filter_9_data,
-      bias_shape_9,
-      bias_9_data,
-      output_shape_9,
-      output0  // output
-  );
-#endif
+// Runs a single op of the float reference, mirroring waist_run_op(). Op 3
+// also runs op 6, with input2_data the op 5 output.
+static void waist_float_op(int op, const float* input_data,
+                           const float* input2_data, float* output_data) {
+  float product[18];
+  switch (op) {
+    case 0:
+      FloatFullyConnected(float_params_0, input_shape_0, input_data,
+                          filter_shape_0, filter_0_data, bias_shape_0,
+                          bias_0_data, output_shape_0, output_data);
+      break;
+    case 1:
+      FloatFullyConnected(float_params_1, input_shape_1, input_data,
+                          filter_shape_1, filter_1_data, bias_shape_1,
+                          bias_1_data, output_shape_1, output_data);
+      break;
+    case 3:
+      FloatFullyConnected(float_params_3, input_shape_3, input_data,
+                          filter_shape_3, filter_3_data, bias_shape_3,
+                          bias_3_data, output_shape_3, product);
+      FloatAdd(input1_shape_6, input2_data, input2_shape_6, product,
+               output_shape_6, output_data);
+      break;
+    case 5:
+      FloatFullyConnected(float_params_5, input_shape_5, input_data,
+                          filter_shape_5, filter_5_data, bias_shape_5,
+                          bias_5_data, output_shape_5, output_data);
+      break;
+    case 8:
+      FloatFullyConnected(float_params_8, input_shape_8, input_data,
+                          filter_shape_8, filter_8_data, bias_shape_8,
+                          bias_8_data, output_shape_8, output_data);
+      break;
+    case 9:
+      FloatFullyConnected(float_params_9, input_shape_9, input_data,
+                          filter_shape_9, filter_9_data, bias_shape_9,
+                          bias_9_data, output_shape_9, output_data);
+      break;
+  }
+}
 
-  return 0;
+void custom_waist_float_inference(const float* input_vals,
+                                 const float* state_vals, float* output_vals,
+                                 float* state_out_vals) {
+  float op0_output_f[8];
+  float op1_output_f[3];
+  float op5_output_f[18];
+  float op8_output_f[15];
+
+  waist_float_op(0, input_vals, nullptr, op0_output_f);
+  waist_float_op(1, op0_output_f, nullptr, op1_output_f);
+  waist_float_op(5, state_vals, nullptr, op5_output_f);
+  waist_float_op(3, op1_output_f, op5_output_f, state_out_vals);
+  waist_float_op(8, state_out_vals, nullptr, op8_output_f);
+  waist_float_op(9, op8_output_f, nullptr, output_vals);
+}
+
+int custom_waist_compare_ops(OpDeviation* deviations, int max_deviations) {
+  const QuantizedTensor input0_t = {
+      input0, kModelInputSize, input0_scale, input0_zero_point};
+  const QuantizedTensor input1_t = {
+      input1, kStateInputSize, input1_scale, input1_zero_point};
+  const QuantizedTensor output0_t = {
+      output0, kOutputSize, output0_scale, output0_zero_point};
+  const QuantizedTensor output1_t = {
+      output1, kStateInputSize, output1_scale, output1_zero_point};
+  const QuantizedTensor op0_output_t = {
+      op0_output, output_shape_0.FlatSize(), op0_output_scale,
+      op0_output_zero_point};
+  const QuantizedTensor op1_output_t = {
+      op1_output, output_shape_1.FlatSize(), op1_output_scale,
+      op1_output_zero_point};
+  const QuantizedTensor op5_output_t = {
+      op5_output, output_shape_5.FlatSize(), op5_output_scale,
+      op5_output_zero_point};
+  const QuantizedTensor op8_output_t = {
+      op8_output, output_shape_8.FlatSize(), op8_output_scale,
+      op8_output_zero_point};
+  const QuantizedTensor none = {nullptr, 0, 0.0f, 0};
+
+  // Ops in execution order, as in custom_waist_inference()
+  const struct {
+    int op;
+    const char* name;
+    KernelImpl impl;
+    QuantizedTensor input, input2, output;
+  } ops[] = {
+      {0, "FULLY_CONNECTED", kWaistOp0Kernel, input0_t, none, op0_output_t},
+      {1, "FULLY_CONNECTED", kWaistOp1Kernel, op0_output_t, none, op1_output_t},
+      {5, "FULLY_CONNECTED", kWaistOp5Kernel, input1_t, none, op5_output_t},
+      {3, "FULLY_CONNECTED + ADD (op 6)", kWaistOp3Kernel, op1_output_t,
+       op5_output_t, output1_t},
+      {8, "FULLY_CONNECTED", kWaistOp8Kernel, output1_t, none, op8_output_t},
+      {9, "FULLY_CONNECTED", kWaistOp9Kernel, op8_output_t, none, output0_t},
+  };
+  const int num_ops = sizeof(ops) / sizeof(ops[0]);
+  if (max_deviations < num_ops) {
+    return -1;
+  }
+
+  // Every op is fed the dequantized int8 inputs, so that the deviation is
+  // that of the op alone and does not accumulate along the graph
+  float input[18], input2[18], expected[18], actual[18];
+  for (int i = 0; i < num_ops; i++) {
+    waist_run_op(ops[i].op, ops[i].impl);
+
+    const QuantizedTensor& in = ops[i].input;
+    const QuantizedTensor& in2 = ops[i].input2;
+    const QuantizedTensor& out = ops[i].output;
+    Dequantize(in.data, in.size, in.scale, in.zero_point, input);
+    if (in2.data) {
+      Dequantize(in2.data, in2.size, in2.scale, in2.zero_point, input2);
+    }
+    waist_float_op(ops[i].op, input, input2, expected);
+    Dequantize(out.data, out.size, out.scale, out.zero_point, actual);
+
+    deviations[i].op = ops[i].op;
+    deviations[i].name = ops[i].name;
+    deviations[i].max_abs_error = MaxAbsError(expected, actual, out.size);
+    deviations[i].output_scale = out.scale;
+  }
+
+  return num_ops;
 }
@@ -0,0 +1,31 @@
+// Per-op kernel dispatch table for the chest model.
+//
+// Regenerate with the kernel tuner (``custom_bin chest tune``, see
+// custom_dispatch.h) on the target and replace this file whenever the model,
+// the kernels or the compiler flags change. The current table matches the
+// previous pod build: CMSIS for ops 0 and 8, reference for the ops that were
+// slower with CMSIS (CMSIS_FC_EXTRA) and the fused kernel for ops 3 and 6.
+#ifndef __ABR_DISPATCH_CHEST_H__
+#define __ABR_DISPATCH_CHEST_H__
+
+#include "custom_dispatch.h"
+
+//--- Op 0: FULLY_CONNECTED
+constexpr KernelImpl kChestOp0Kernel = kKernelCmsis;
+
+//--- Op 1: FULLY_CONNECTED
+constexpr KernelImpl kChestOp1Kernel = kKernelReference;
+
+//--- Op 5: FULLY_CONNECTED
+constexpr KernelImpl kChestOp5Kernel = kKernelReference;
+
+//--- Op 3: FULLY_CONNECTED + ADD (op 6)
+constexpr KernelImpl kChestOp3Kernel = kKernelReference;
+
+//--- Op 8: FULLY_CONNECTED
+constexpr KernelImpl kChestOp8Kernel = kKernelCmsis;
+
+//--- Op 9: FULLY_CONNECTED
+constexpr KernelImpl kChestOp9Kernel = kKernelReference;
+
+#endif  // __ABR_DISPATCH_CHEST_H__
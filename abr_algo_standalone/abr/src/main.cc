@@ -34,6 +34,7 @@ limitations under the License.
 // }
 
 #include <string.h>  // strlen
+#include <chrono>
 #include <cstdio>
 #include <math.h>
 
@@ -42,11 +43,139 @@ limitations under the License.
 #include "data_waist.h"
 #include "custom_chest.h"
 #include "custom_waist.h"
+#include "custom_float_kernels.h"
 
 // constexpr int kModelInputSize = 3;  // Number of model input values
 // constexpr int kOutputSize = 10;  // Number of model output values
 // constexpr int kStateInputSize = 14;  // Total number of model states
 
+// Kernel tuner settings
+constexpr int kTuneWarmupSteps = 64;
+constexpr int kTuneIterations = 10000;
+
+// Host tick counter for the kernel tuner, in nanoseconds
+uint32_t host_clock() {
+  using namespace std::chrono;
+  return static_cast<uint32_t>(
+      duration_cast<nanoseconds>(steady_clock::now().time_since_epoch())
+          .count());
+}
+
+// Float reference comparison settings
+constexpr int kMaxCompareOps = 16;
+
+// Model functions used by the float reference comparison
+struct ModelApi {
+  void (*set_inputs)(float*);
+  void (*set_states)(float*);
+  void (*get_states)(float*);
+  void (*get_outputs)(float*);
+  int (*inference)();
+  void (*float_inference)(const float*, const float*, float*, float*);
+  int (*compare_ops)(OpDeviation*, int);
+  float (*preproc_data)[N_CHANNELS];
+  float (*reference_output)[N_OUTPUTS];
+};
+
+// Runs the int8 model and its float reference on the preprocessed reference
+// data and reports the per-op and end-to-end deviation and the timing of both
+int compare_float_reference(const ModelApi& model) {
+  float states[kStateInputSize] = {0};
+  float outputs[kOutputSize] = {0};
+  float float_states[kStateInputSize] = {0};
+  float float_outputs[kOutputSize] = {0};
+
+  OpDeviation deviations[kMaxCompareOps];
+  float op_max_error[kMaxCompareOps] = {0};
+  float op_sum_error[kMaxCompareOps] = {0};
+  int num_ops = 0;
+
+  float output_max_error = 0.0f;
+  float output_sum_error = 0.0f;
+  float state_max_error = 0.0f;
+  float ref_max_error = 0.0f;
+  float float_ref_max_error = 0.0f;
+
+  // Accuracy: both models run free, each with its own states
+  for (int i = 0; i < N_STEPS; i++) {
+    model.set_inputs(model.preproc_data[i]);
+    model.set_states(states);
+    num_ops = model.compare_ops(deviations, kMaxCompareOps);
+    if (num_ops < 0) {
+      printf("Too many ops to compare\n\r");
+      return 1;
+    }
+    model.get_states(states);
+    model.get_outputs(outputs);
+
+    model.float_inference(model.preproc_data[i], float_states, float_outputs,
+                          float_states);
+
+    for (int k = 0; k < num_ops; k++) {
+      op_max_error[k] = std::max(op_max_error[k], deviations[k].max_abs_error);
+      op_sum_error[k] += deviations[k].max_abs_error;
+    }
+
+    const float output_error = MaxAbsError(outputs, float_outputs, kOutputSize);
+    output_max_error = std::max(output_max_error, output_error);
+    output_sum_error += output_error;
+    state_max_error = std::max(
+        state_max_error, MaxAbsError(states, float_states, kStateInputSize));
+    ref_max_error = std::max(
+        ref_max_error,
+        MaxAbsError(outputs, model.reference_output[i], kOutputSize));
+    float_ref_max_error = std::max(
+        float_ref_max_error,
+        MaxAbsError(float_outputs, model.reference_output[i], kOutputSize));
+  }
+
+  printf("Per-op deviation from the float reference over %d steps\n\r",
+         N_STEPS);
+  for (int k = 0; k < num_ops; k++) {
+    printf("  Op %d %-28s max %.6f (%.2f LSB), mean %.6f\n\r",
+           deviations[k].op, deviations[k].name,
+           static_cast<double>(op_max_error[k]),
+           static_cast<double>(op_max_error[k] / deviations[k].output_scale),
+           static_cast<double>(op_sum_error[k] / N_STEPS));
+  }
+  printf("End-to-end deviation from the float reference\n\r");
+  printf("  output max %.6f, mean %.6f; state max %.6f\n\r",
+         static_cast<double>(output_max_error),
+         static_cast<double>(output_sum_error / N_STEPS),
+         static_cast<double>(state_max_error));
+  printf("Deviation from the reference output (TFLite)\n\r");
+  printf("  int8 max %.6f, float max %.6f\n\r",
+         static_cast<double>(ref_max_error),
+         static_cast<double>(float_ref_max_error));
+
+  // Timing, without the comparison overhead
+  for (int j = 0; j < kStateInputSize; j++) {
+    states[j] = float_states[j] = 0.0f;
+  }
+  uint32_t start = host_clock();
+  for (int i = 0; i < N_STEPS; i++) {
+    model.set_inputs(model.preproc_data[i]);
+    model.set_states(states);
+    model.inference();
+    model.get_states(states);
+    model.get_outputs(outputs);
+  }
+  const uint32_t int8_ticks = host_clock() - start;
+
+  start = host_clock();
+  for (int i = 0; i < N_STEPS; i++) {
+    model.float_inference(model.preproc_data[i], float_states, float_outputs,
+                          float_states);
+  }
+  const uint32_t float_ticks = host_clock() - start;
+
+  printf("Time per step: int8 %lu ns, float %lu ns\n\r",
+         static_cast<unsigned long>(int8_ticks / N_STEPS),
+         static_cast<unsigned long>(float_ticks / N_STEPS));
+
+  return 0;
+}
+
 int main(int argc, char *argv[]) {
   int status = 0;
 
@@ -65,12 +194,63 @@ int main(int argc, char *argv[]) {
       }
   }
 
+  // whether to run the kernel tuner or the float reference comparison
+  // instead of the reference comparison
+  int tune = 0;
+  int compare = 0;
+  if (argc > 2) {
+      tune = (strcmp(argv[2], "tune") == 0);
+      compare = (strcmp(argv[2], "compare") == 0);
+  }
+
   // setup TFLite
   if (use_waist) {
       status = custom_waist_setup(kHostInputSize, kStateInputSize, kOutputSize);
   } else {
       status = custom_chest_setup(kHostInputSize, kStateInputSize, kOutputSize);
   }
+
+  if (tune && status == 0) {
+    // Run some preprocessed reference data through the model so that every op
+    // sees realistic activations, then print the tuned dispatch table
+    float tune_states[kStateInputSize] = {0};
+    for (int i = 0; i < kTuneWarmupSteps; i++) {
+      if (use_waist) {
+        custom_waist_set_inputs(waist_preproc_data[i % N_STEPS]);
+        custom_waist_set_states(tune_states);
+        custom_waist_inference();
+        custom_waist_get_states(tune_states);
+      } else {
+        custom_chest_set_inputs(chest_preproc_data[i % N_STEPS]);
+        custom_chest_set_states(tune_states);
+        custom_chest_inference();
+        custom_chest_get_states(tune_states);
+      }
+    }
+
+    if (use_waist) {
+      return custom_waist_tune(host_clock, kTuneIterations);
+    }
+    return custom_chest_tune(host_clock, kTuneIterations);
+  }
+
+  if (compare && status == 0) {
+    if (use_waist) {
+      const ModelApi waist = {
+          custom_waist_set_inputs, custom_waist_set_states,
+          custom_waist_get_states, custom_waist_get_outputs,
+          custom_waist_inference, custom_waist_float_inference,
+          custom_waist_compare_ops, waist_preproc_data, waist_reference_output};
+      return compare_float_reference(waist);
+    }
+    const ModelApi chest = {
+        custom_chest_set_inputs, custom_chest_set_states,
+        custom_chest_get_states, custom_chest_get_outputs,
+        custom_chest_inference, custom_chest_float_inference,
+        custom_chest_compare_ops, chest_preproc_data, chest_reference_output};
+    return compare_float_reference(chest);
+  }
+
   printf("\n\rUsing custom implementation (use_waist=%d)\n\r", use_waist);
 
   if (status != 0) {
@@ -0,0 +1,318 @@
+"""Offline activation memory planner for the generated pod models.
+
+Reads a TFLite model, works out the lifetime of every intermediate activation
+tensor in the order the C++ library runs the ops, and packs them into a single
+arena with a greedy best-offset allocator (largest tensors first). The result
+is written as a ``src/arena_<garment>.h`` header with the arena size and the
+offset of each op output, and the peak activation RAM is reported per model.
+
+Model inputs and outputs (``input0``, ``input1``, ``output0``, ``output1``) are
+owned by the model API and are not part of the arena. RESHAPE ops are no-ops
+in the C++ library, so their output aliases their input. An outer-product
+FULLY_CONNECTED whose only consumer is an ADD is fused with it (see
+``OuterProductAdd`` in ``custom_kernels.h``) unless ``--no-fuse`` is given,
+so its output is never materialized.
+
+Only the Python standard library is used, so this runs without TensorFlow.
+
+Usage::
+
+    python plan_arena.py                  # plan chest and waist, write headers
+    python plan_arena.py --dry-run        # only report the layouts
+"""
+
+import argparse
+import pathlib
+import struct
+
+file_dir = pathlib.Path(__file__).parent
+
+MODELS = {
+    "chest": file_dir / "../../myant-lmu-rq-pod-chest-sow2v1_keras_model.tflite",
+    "waist": file_dir / "../../myant-lmu-rq-pod-waist-sow2v2_keras_model.tflite",
+}
+
+# TFLite builtin operator codes and tensor types used by the pod models
+OP_NAMES = {0: "ADD", 9: "FULLY_CONNECTED", 22: "RESHAPE"}
+TYPE_SIZES = {0: 4, 2: 4, 3: 1, 9: 1}  # float32, int32, uint8, int8
+
+
+class FlatBuffer:
+    """Minimal reader for the parts of the TFLite flatbuffer schema we need."""
+
+    def __init__(self, data):
+        self.data = data
+
+    def u8(self, o):
+        return self.data[o]
+
+    def i8(self, o):
+        return struct.unpack_from("<b", self.data, o)[0]
+
+    def u32(self, o):
+        return struct.unpack_from("<I", self.data, o)[0]
+
+    def i32(self, o):
+        return struct.unpack_from("<i", self.data, o)[0]
+
+    def deref(self, o):
+        return o + self.u32(o)
+
+    def table(self, o):
+        """Return a function mapping a field index to its offset (or None)."""
+        vtable = o - self.i32(o)
+        vtable_size = struct.unpack_from("<H", self.data, vtable)[0]
+
+        def field(i):
+            if 4 + 2 * i >= vtable_size:
+                return None
+            off = struct.unpack_from("<H", self.data, vtable + 4 + 2 * i)[0]
+            return o + off if off else None
+
+        return field
+
+    def vector(self, o):
+        """Return (start, length) of the vector referenced at ``o``."""
+        o = self.deref(o)
+        return o + 4, self.u32(o)
+
+    def int_vector(self, o):
+        if o is None:
+            return []
+        start, n = self.vector(o)
+        return [self.i32(start + 4 * i) for i in range(n)]
+
+    def tables(self, o):
+        start, n = self.vector(o)
+        return [self.table(self.deref(start + 4 * i)) for i in range(n)]
+
+
+class Graph:
+    """Tensors and ops of the first subgraph of a TFLite model."""
+
+    def __init__(self, path):
+        fb = FlatBuffer(pathlib.Path(path).read_bytes())
+        model = fb.table(fb.u32(0))
+
+        opcodes = []
+        for code in fb.tables(model(1)):
+            # builtin_code (field 3) replaced deprecated_builtin_code (field 0)
+            deprecated = fb.i8(code(0)) if code(0) else 0
+            builtin = fb.i32(code(3)) if code(3) else 0
+            opcodes.append(max(deprecated, builtin))
+
+        has_data = []
+        for buf in fb.tables(model(4)):
+            has_data.append(buf(0) is not None and fb.vector(buf(0))[1] > 0)
+
+        subgraph = fb.tables(model(2))[0]
+        self.tensors = []
+        for t in fb.tables(subgraph(0)):
+            shape = fb.int_vector(t(0))
+            dtype = fb.u8(t(1)) if t(1) else 0
+            buffer = fb.u32(t(2)) if t(2) else 0
+            size = TYPE_SIZES[dtype]
+            for dim in shape:
+                size *= dim
+            self.tensors.append(dict(shape=shape, size=size, const=has_data[buffer]))
+
+        self.inputs = fb.int_vector(subgraph(1))
+        self.outputs = fb.int_vector(subgraph(2))
+        self.ops = []
+        for op in fb.tables(subgraph(3)):
+            opcode = opcodes[fb.u32(op(0)) if op(0) else 0]
+            self.ops.append(
+                dict(
+                    name=OP_NAMES.get(opcode, f"OP_{opcode}"),
+                    inputs=[i for i in fb.int_vector(op(1)) if i >= 0],
+                    outputs=fb.int_vector(op(2)),
+                )
+            )
+
+    def consumers(self, tensor):
+        return [i for i, op in enumerate(self.ops) if tensor in op["inputs"]]
+
+
+def schedule(graph, fuse=True):
+    """Return the ops in execution order as lists of graph op indices.
+
+    Each entry is one kernel call: a single op, or a fused FULLY_CONNECTED +
+    ADD pair, which runs in place of the ADD.
+    """
+    fused = {}
+    if fuse:
+        for i, op in enumerate(graph.ops):
+            if op["name"] != "FULLY_CONNECTED":
+                continue
+            filter_shape = graph.tensors[op["inputs"][1]]["shape"]
+            consumers = graph.consumers(op["outputs"][0])
+            if (
+                filter_shape[-1] == 1
+                and len(consumers) == 1
+                and graph.ops[consumers[0]]["name"] == "ADD"
+            ):
+                fused[consumers[0]] = i
+
+    order = []
+    for i in range(len(graph.ops)):
+        if i in fused.values():
+            continue
+        order.append([fused[i], i] if i in fused else [i])
+    return order
+
+
+def plan(graph, order):
+    """Compute activation lifetimes and arena offsets.
+
+    Returns a list of buffers (dicts with the producing op, size, first and
+    last step, and offset) and the arena size.
+    """
+    io = set(graph.inputs) | set(graph.outputs)
+
+    # Map every tensor to the tensor that owns its memory. RESHAPE outputs
+    # alias their input; a group that reaches a model input or output lives
+    # there, otherwise it is owned by its lowest numbered tensor.
+    groups = {t: {t} for t in range(len(graph.tensors))}
+    for op in graph.ops:
+        if op["name"] == "RESHAPE":
+            merged = groups[op["inputs"][0]] | groups[op["outputs"][0]]
+            for t in merged:
+                groups[t] = merged
+
+    def root(t):
+        members = groups[t]
+        return min(members & io) if members & io else min(members)
+
+    buffers = {}
+    for step, kernel in enumerate(order):
+        internal = set()
+        if len(kernel) > 1:
+            internal = {t for i in kernel[:-1] for t in graph.ops[i]["outputs"]}
+        for i in kernel:
+            op = graph.ops[i]
+            if op["name"] == "RESHAPE":
+                continue
+            for t in op["inputs"] + op["outputs"]:
+                r = root(t)
+                if graph.tensors[t]["const"] or r in io or t in internal:
+                    continue
+                if r not in buffers:
+                    buffers[r] = dict(
+                        op=i,
+                        size=graph.tensors[r]["size"],
+                        first=step,
+                        last=step,
+                    )
+                buffers[r]["first"] = min(buffers[r]["first"], step)
+                buffers[r]["last"] = max(buffers[r]["last"], step)
+
+    # Greedy by size: place each buffer at the lowest offset that does not
+    # overlap any already placed buffer that is live at the same time.
+    placed = []
+    for buf in sorted(buffers.values(), key=lambda b: (-b["size"], b["first"])):
+        live = sorted(
+            (p["offset"], p["offset"] + p["size"])
+            for p in placed
+            if p["first"] <= buf["last"] and buf["first"] <= p["last"]
+        )
+        offset = 0
+        for start, end in live:
+            if offset + buf["size"] <= start:
+                break
+            offset = max(offset, end)
+        buf["offset"] = offset
+        placed.append(buf)
+
+    arena_size = max((b["offset"] + b["size"] for b in placed), default=0)
+    return sorted(placed, key=lambda b: b["first"]), arena_size
+
+
+def peak_live(buffers, n_steps):
+    """Lower bound on the arena size: the most bytes live at any one step."""
+    return max(
+        (
+            sum(b["size"] for b in buffers if b["first"] <= s <= b["last"])
+            for s in range(n_steps)
+        ),
+        default=0,
+    )
+
+
+def header(garment, model_path, graph, order, buffers, arena_size):
+    title = garment.title()
+    upper = garment.upper()
+    kernels = ", ".join("+".join(str(i) for i in k) for k in order)
+    lines = [
+        f"// Activation arena layout for the {garment} model.",
+        "//",
+        "// Generated by plan_arena.py from",
+        f"// {model_path.name}.",
+        "// Do not edit; re-run the planner whenever the model or the op schedule",
+        "// in custom_<garment>.cc changes.",
+        "//",
+        f"// Kernels, in execution order: {kernels}",
+        f"#ifndef __ABR_ARENA_{upper}_H__",
+        f"#define __ABR_ARENA_{upper}_H__",
+        "",
+        f"constexpr int k{title}ArenaSize = {arena_size};",
+        "",
+    ]
+    for b in buffers:
+        op = graph.ops[b["op"]]
+        lines.append(
+            f"//--- Op {b['op']}: {op['name']} output, {b['size']} bytes, "
+            f"live for kernels {b['first']}-{b['last']}"
+        )
+        lines.append(f"constexpr int k{title}Op{b['op']}Output = {b['offset']};")
+    lines += ["", f"#endif  // __ABR_ARENA_{upper}_H__", ""]
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Pod model activation planner")
+    parser.add_argument("garments", nargs="*", default=list(MODELS))
+    parser.add_argument(
+        "--no-fuse", action="store_true", help="do not fuse outer product + add"
+    )
+    parser.add_argument(
+        "--dry-run", action="store_true", help="report only, do not write headers"
+    )
+    args = parser.parse_args()
+
+    total = 0
+    largest = 0
+    for garment in args.garments:
+        model_path = MODELS[garment].resolve()
+        graph = Graph(model_path)
+        order = schedule(graph, fuse=not args.no_fuse)
+        buffers, arena_size = plan(graph, order)
+        total += arena_size
+        largest = max(largest, arena_size)
+
+        print(f"{garment}: {len(order)} kernels, {len(buffers)} activation buffers")
+        for b in buffers:
+            print(
+                f"  op {b['op']:2d} output: {b['size']:4d} bytes at offset "
+                f"{b['offset']:4d}, kernels {b['first']}-{b['last']}"
+            )
+        print(
+            f"  peak activation RAM: {arena_size} bytes "
+            f"(lower bound {peak_live(buffers, len(order))})"
+        )
+
+        if not args.dry_run:
+            out_path = file_dir / "src" / f"arena_{garment}.h"
+            out_path.write_text(
+                header(garment, model_path, graph, order, buffers, arena_size)
+            )
+            print(f"  wrote {out_path.relative_to(file_dir)}")
+
+    if len(args.garments) > 1:
+        print(
+            f"all models: {total} bytes with separate arenas, "
+            f"{largest} bytes if they share one"
+        )
+
+
+if __name__ == "__main__":
+    main()
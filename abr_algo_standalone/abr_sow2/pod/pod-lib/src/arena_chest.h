@@ -0,0 +1,23 @@
+// Activation arena layout for the chest model.
+//
+// Generated by plan_arena.py from
+// myant-lmu-rq-pod-chest-sow2v1_keras_model.tflite.
+// Do not edit; re-run the planner whenever the model or the op schedule
+// in custom_<garment>.cc changes.
+//
+// Kernels, in execution order: 0, 1, 2, 4, 5, 3+6, 7, 8, 9
+#ifndef __ABR_ARENA_CHEST_H__
+#define __ABR_ARENA_CHEST_H__
+
+constexpr int kChestArenaSize = 21;
+
+//--- Op 0: FULLY_CONNECTED output, 8 bytes, live for kernels 0-1
+constexpr int kChestOp0Output = 0;
+//--- Op 1: FULLY_CONNECTED output, 3 bytes, live for kernels 1-5
+constexpr int kChestOp1Output = 18;
+//--- Op 5: FULLY_CONNECTED output, 18 bytes, live for kernels 4-5
+constexpr int kChestOp5Output = 0;
+//--- Op 8: FULLY_CONNECTED output, 15 bytes, live for kernels 7-8
+constexpr int kChestOp8Output = 0;
+
+#endif  // __ABR_ARENA_CHEST_H__
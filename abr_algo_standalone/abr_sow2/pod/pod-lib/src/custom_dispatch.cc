@@ -0,0 +1,93 @@
+#include "custom_dispatch.h"
+
+namespace {
+  constexpr int kMaxTunerOps = 16;
+  constexpr int kMaxTunerOutputSize = 64;
+  constexpr int kMaxModelNameSize = 16;
+}
+
+int TuneKernels(const char* model_name, const TunerOp* ops, int num_ops,
+                TunerRunOp run_op, TunerClock clock, int iterations) {
+  KernelImpl best_impl[kMaxTunerOps];
+  uint32_t ticks[kMaxTunerOps][kNumKernelImpls];
+  bool exact[kMaxTunerOps][kNumKernelImpls];
+  int8_t expected[kMaxTunerOutputSize];
+
+  if (num_ops > kMaxTunerOps) {
+    printf("Too many ops to tune: %d (max %d)\n\r", num_ops, kMaxTunerOps);
+    return 1;
+  }
+
+  for (int i = 0; i < num_ops; i++) {
+    const TunerOp& op = ops[i];
+    if (op.output_size > kMaxTunerOutputSize) {
+      printf("Op %d output too large to tune: %d\n\r", op.op, op.output_size);
+      return 1;
+    }
+
+    // The reference output is what every other kernel has to reproduce. The
+    // op inputs are untouched by running the op, so it can be run repeatedly.
+    run_op(op.op, kKernelReference);
+    memcpy(expected, op.output, op.output_size);
+
+    best_impl[i] = kKernelReference;
+    for (int k = 0; k < kNumKernelImpls; k++) {
+      const KernelImpl impl = static_cast<KernelImpl>(k);
+
+      run_op(op.op, impl);
+      exact[i][k] = (memcmp(expected, op.output, op.output_size) == 0);
+
+      const uint32_t start = clock();
+      for (int n = 0; n < iterations; n++) {
+        run_op(op.op, impl);
+      }
+      ticks[i][k] = clock() - start;
+
+      if (exact[i][k] && ticks[i][k] < ticks[i][best_impl[i]]) {
+        best_impl[i] = impl;
+      }
+    }
+
+    // Leave the reference result in place for the ops that follow
+    run_op(op.op, kKernelReference);
+  }
+
+  char lower[kMaxModelNameSize];
+  char upper[kMaxModelNameSize];
+  char title[kMaxModelNameSize];
+  int len = 0;
+  for (; model_name[len] != '\0' && len < kMaxModelNameSize - 1; len++) {
+    const char c = model_name[len];
+    lower[len] = (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+    upper[len] = (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+    title[len] = (len == 0) ? upper[len] : lower[len];
+  }
+  lower[len] = upper[len] = title[len] = '\0';
+
+  printf("// Per-op kernel dispatch table for the %s model.\n", lower);
+  printf("//\n");
+  printf("// Generated by the kernel tuner (``custom_bin %s tune``, see\n", lower);
+  printf("// custom_dispatch.h). Re-run the tuner on the target and replace this\n");
+  printf("// file whenever the model, the kernels or the compiler flags change.\n");
+  printf("#ifndef __ABR_DISPATCH_%s_H__\n", upper);
+  printf("#define __ABR_DISPATCH_%s_H__\n", upper);
+  printf("\n");
+  printf("#include \"custom_dispatch.h\"\n");
+  for (int i = 0; i < num_ops; i++) {
+    printf("\n");
+    printf("//--- Op %d: %s (ticks per %d runs:", ops[i].op, ops[i].name,
+           iterations);
+    for (int k = 0; k < kNumKernelImpls; k++) {
+      printf(" %s %lu%s", KernelImplName(static_cast<KernelImpl>(k)),
+             static_cast<unsigned long>(ticks[i][k]),
+             exact[i][k] ? "" : " (not bit-exact)");
+    }
+    printf(")\n");
+    printf("constexpr KernelImpl k%sOp%dKernel = %s;\n", title, ops[i].op,
+           KernelImplConstant(best_impl[i]));
+  }
+  printf("\n");
+  printf("#endif  // __ABR_DISPATCH_%s_H__\n", upper);
+
+  return 0;
+}
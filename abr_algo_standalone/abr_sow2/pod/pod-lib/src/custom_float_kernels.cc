@@ -0,0 +1,66 @@
+#include <algorithm>
+#include <cmath>
+
+#include "custom_float_kernels.h"
+
+void FloatFullyConnected(
+    const FloatFullyConnectedParams& params,
+    const RuntimeShape& input_shape, const float* input_data,
+    const RuntimeShape& filter_shape, const int8_t* filter_data,
+    const RuntimeShape& bias_shape, const int32_t* bias_data,
+    const RuntimeShape& output_shape, float* output_data
+) {
+  TFLITE_DCHECK_GE(filter_shape.DimensionsCount(), 2);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 2);
+
+  const int filter_dim_count = filter_shape.DimensionsCount();
+  const int batches = output_shape.Dims(0);
+  const int output_depth = output_shape.Dims(1);
+  TFLITE_DCHECK_LE(output_depth, filter_shape.Dims(filter_dim_count - 2));
+  const int accum_depth = filter_shape.Dims(filter_dim_count - 1);
+  for (int b = 0; b < batches; ++b) {
+    for (int out_c = 0; out_c < output_depth; ++out_c) {
+      float acc = 0.0f;
+      for (int d = 0; d < accum_depth; ++d) {
+        acc += input_data[b * accum_depth + d] *
+               static_cast<float>(filter_data[out_c * accum_depth + d]);
+      }
+      acc *= params.filter_scale;
+      if (bias_data) {
+        acc += static_cast<float>(bias_data[out_c]) * params.bias_scale;
+      }
+      if (params.relu) {
+        acc = std::max(acc, 0.0f);
+      }
+      output_data[out_c + output_depth * b] = acc;
+    }
+  }
+}
+
+void FloatAdd(
+    const RuntimeShape& input1_shape, const float* input1_data,
+    const RuntimeShape& input2_shape, const float* input2_data,
+    const RuntimeShape& output_shape, float* output_data
+) {
+  const int size = output_shape.FlatSize();
+  TFLITE_DCHECK_EQ(input1_shape.FlatSize(), size);
+  TFLITE_DCHECK_EQ(input2_shape.FlatSize(), size);
+  for (int i = 0; i < size; ++i) {
+    output_data[i] = input1_data[i] + input2_data[i];
+  }
+}
+
+void Dequantize(const int8_t* input_data, int size, float scale,
+                int32_t zero_point, float* output_data) {
+  for (int i = 0; i < size; ++i) {
+    output_data[i] = (input_data[i] - zero_point) * scale;
+  }
+}
+
+float MaxAbsError(const float* a, const float* b, int size) {
+  float max_error = 0.0f;
+  for (int i = 0; i < size; ++i) {
+    max_error = std::max(max_error, std::fabs(a[i] - b[i]));
+  }
+  return max_error;
+}
@@ -0,0 +1,51 @@
+#ifndef __ABR_CUSTOM_FLOAT_KERNELS_H__
+#define __ABR_CUSTOM_FLOAT_KERNELS_H__
+
+#include "custom_types.h"
+
+// Float32 reference kernels. They run the same graph as the int8 kernels, with
+// the weights and biases dequantized from the int8/int32 model data, so that
+// quantization error can be told apart from the error of faster kernels.
+
+struct FloatFullyConnectedParams {
+  float filter_scale;  // scale of the int8 filter data
+  float bias_scale;    // scale of the int32 bias data (input * filter scale)
+  bool relu;           // fused ReLU activation
+};
+
+// An int8 tensor of the model with its quantization parameters
+struct QuantizedTensor {
+  const int8_t* data;
+  int size;
+  float scale;
+  int32_t zero_point;
+};
+
+// Deviation of one op (or fused group of ops) of the int8 model from the float
+// reference, given the same (dequantized) inputs.
+struct OpDeviation {
+  int op;               // op index in the model graph
+  const char* name;     // op type
+  float max_abs_error;  // largest deviation of any output element
+  float output_scale;   // output quantization step, to express errors in LSBs
+};
+
+void FloatFullyConnected(
+    const FloatFullyConnectedParams& params,
+    const RuntimeShape& input_shape, const float* input_data,
+    const RuntimeShape& filter_shape, const int8_t* filter_data,
+    const RuntimeShape& bias_shape, const int32_t* bias_data,
+    const RuntimeShape& output_shape, float* output_data);
+
+void FloatAdd(
+    const RuntimeShape& input1_shape, const float* input1_data,
+    const RuntimeShape& input2_shape, const float* input2_data,
+    const RuntimeShape& output_shape, float* output_data);
+
+void Dequantize(const int8_t* input_data, int size, float scale,
+                int32_t zero_point, float* output_data);
+
+// Returns the largest absolute difference between ``a`` and ``b``
+float MaxAbsError(const float* a, const float* b, int size);
+
+#endif  // __ABR_CUSTOM_FLOAT_KERNELS_H__
@@ -64,6 +64,20 @@ void FullyConnected(
     const int32_t* bias_data, const RuntimeShape& output_shape,
     int8_t* output_data);
 
+// Fused outer product (a FULLY_CONNECTED of a {rows, 1} input with a {cols, 1}
+// filter and no bias) followed by an ADD of a {rows, cols} addend, as used by
+// the LMU memory update. Bit-exact with FullyConnected() into an int8 buffer
+// followed by Add(add_params, addend, product), but without the intermediate
+// buffer. When the addend is rescaled by exactly one half (the usual case, as
+// the larger input scale is used as the ADD reference), its multiply is a
+// shift and only one requantization is done per element for the ADD inputs.
+void OuterProductAdd(
+    const FullyConnectedParams& fc_params, const ArithmeticParams& add_params,
+    const RuntimeShape& input_shape, const int8_t* input_data,
+    const RuntimeShape& filter_shape, const int8_t* filter_data,
+    const RuntimeShape& addend_shape, const int8_t* addend_data,
+    const RuntimeShape& output_shape, int8_t* output_data);
+
 void Requantize(const int8_t* input_data, int32_t size,
                        int32_t effective_scale_multiplier,
                        int32_t effective_scale_shift, int32_t input_zeropoint,
@@ -1,6 +1,10 @@
 #ifndef __ABR_CUSTOM_WAIST_H__
 #define __ABR_CUSTOM_WAIST_H__
 
+#include <stdint.h>
+
+struct OpDeviation;
+
 /* ****************************************************************************
  * This function sets up the runtime and allocates all the required resources
  * for model execution.
@@ -50,6 +54,27 @@ void custom_waist_get_states(float* state_vals);
  */
 void custom_waist_set_inputs(float* input_vals);
 
+/* ****************************************************************************
+ * This function sets the model inputs from values that are already scaled by
+ * ``custom_waist_get_input_inv_scale()``, e.g. by the caller's quantize step,
+ * and should be called before each inference instead of
+ * ``custom_waist_set_inputs``.
+ *
+ * Internally this only rounds, offsets and saturates the values, without a
+ * division or a libm call.
+ *
+ * scaled_vals: Pointer to memory buffer from which the scaled input values are
+ *              passed into the model. This function consumes
+ *              ``kModelInputSize`` elements from the buffer.
+ */
+void custom_waist_set_scaled_inputs(const float* scaled_vals);
+
+/* ****************************************************************************
+ * This function returns the inverse of the model input quantization scale, by
+ * which inputs are multiplied before ``custom_waist_set_scaled_inputs``.
+ */
+float custom_waist_get_input_inv_scale();
+
 /* ****************************************************************************
  * This function gets the model outputs and should be called after each
  * inference.
@@ -68,4 +93,43 @@ void custom_waist_get_outputs(float* output_vals);
  */
 int custom_waist_inference();
 
+/* ****************************************************************************
+ * This function runs the kernel tuner on the model and prints the generated
+ * ``dispatch_waist.h`` table to stdout. The inputs and states should be set (and
+ * ideally a few inferences run) beforehand so that the ops see realistic data.
+ *
+ * clock: Monotonic tick counter used to time the ops.
+ * iterations: Number of times each op is run per kernel when timing.
+ */
+int custom_waist_tune(uint32_t (*clock)(), int iterations);
+
+/* ****************************************************************************
+ * This function runs the float32 reference of the model: the same graph, with
+ * the weights and biases dequantized from the int8 model data. It does not
+ * touch the int8 inputs, states or outputs of the model.
+ *
+ * input_vals: ``kModelInputSize`` model inputs.
+ * state_vals: ``kStateInputSize`` pre-inference states.
+ * output_vals: Buffer to which ``kOutputSize`` outputs are written.
+ * state_out_vals: Buffer to which ``kStateInputSize`` post-inference states are
+ *                 written.
+ */
+void custom_waist_float_inference(const float* input_vals,
+                                 const float* state_vals, float* output_vals,
+                                 float* state_out_vals);
+
+/* ****************************************************************************
+ * This function performs inference op by op, like ``custom_waist_inference``,
+ * and compares the output of each op with the float reference of that op
+ * given the same (dequantized) inputs. The inputs and states must be set
+ * beforehand; the outputs and states are updated as by inference.
+ *
+ * deviations: Buffer to which the deviation of each op is written, in
+ *             execution order (see custom_float_kernels.h).
+ * max_deviations: Size of the buffer.
+ *
+ * Returns the number of ops compared, or -1 if the buffer is too small.
+ */
+int custom_waist_compare_ops(OpDeviation* deviations, int max_deviations);
+
 #endif  // __ABR_CUSTOM_WAIST_H__
@@ -7,15 +7,27 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#ifdef ECG_ALGO_PROFILE
+#include <time.h>
+#endif
 
 #define GARMENT_ID_DEFAULT GARMENT_CHEST_BAND // Assume chestband for now
 #define NOTCH_FILTER_FREQ  false              // False = 60 Hz, True = 50 Hz
+#define NOTCH_FILTER_AUTO  false              // True = switch to the detected mains frequency
+#define INPUT_ADC_COUNTS   false              // True = feed raw ADC counts (converted from the mV input)
 
-#define ECG_ROLLING_DATA_BUFFER_SIZE 3
-#define ECG_DATA_BUFFER_SIZE         24
+static volatile uint32_t sample_count = 0;
 
-static volatile uint32_t ecg_data_count = 0;
-static volatile uint32_t sample_count   = 0;
+#ifdef ECG_ALGO_PROFILE
+// Nanosecond timer for the ECG algorithm profiling
+static uint32_t profile_timer_ns(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+}
+#endif
 
 int main(int argc, const char *argv[])
 {
@@ -26,23 +38,26 @@ int main(int argc, const char *argv[])
     int   bNumRows             = 0;
 
     // Flags
-    volatile bool ret     = false;    // Return boolean
-    volatile bool restart = true;     // Set true for the first time only, then false afterwards
+    volatile bool ret = false;    // Return boolean
 
     // Intermediate data
-    float buffer[ECG_ROLLING_DATA_BUFFER_SIZE] = {0.0};
-    float algo_output[ECG_ALGO_OUTPUT_SIZE]    = {0};
+    float            pdPacket[ECG_ALGO_PACKET_SIZE * ECG_ALGO_INPUT_SIZE] = {0.0};
+    int32_t          pnPacket[ECG_ALGO_PACKET_SIZE * ECG_ALGO_INPUT_SIZE] = {0};
+    ecg_packet_out_t tPacketOut                                          = {0};
 
     // Outputs
-    uint8_t bRpeakMax   = 0;
-    uint8_t bRpeakIndex = 0;
-    uint8_t fQClass     = 0;
-    uint8_t bSlope      = 0;
-    float   pdBleOuts[7] = {0};
+    float pdBleOuts[8] = {0};
+    float pdRpeak[2]   = {0};
+
+    // BLE frame
+    abr_ble_result_t tBleResult                     = {0};
+    abr_ble_result_t tBleDecoded                    = {0};
+    uint8_t          pbBleFrame[ABR_BLE_FRAME_SIZE] = {0};
 
     // Write CSV header
     const char *pVarNames = "rp_idx,rp_val,q1,q2,q3,slope1,slope2,slope3";
     CSVW_WriteCSVHeader("ble.csv", pVarNames);
+    CSVW_WriteCSVHeader("rpeaks.csv", "timestamp,rr");
 
     // Read Inputs from CSV
     printf("Setting inputs...\r\n");
@@ -51,66 +66,97 @@ int main(int argc, const char *argv[])
     // Update garment ID and notch filter coefficient
     ECGAlgo_SetGarmentID(GARMENT_ID_DEFAULT);
     ABRPreProcess_SetNotchFilterCoeffient(NOTCH_FILTER_FREQ);
+    ABRPreProcess_SetMainsDetection(NOTCH_FILTER_AUTO);
 
     // Initialize the ECG algorithm
     printf("Initializing algorithm...\r\n");
     ECGAlgo_Init();
+#ifdef ECG_ALGO_PROFILE
+    ECGAlgo_SetProfileTimer(profile_timer_ns, 1000000000u);
+#endif
 
-    // Loop through entire input array
+    // Loop through the input array one BLE packet at a time, a trailing
+    // partial packet is dropped
     printf("Looping through input data...\r\n\r\n");
-    for (uint32_t i = 0; i < bNumRows; i++)
+    for (uint32_t i = 0; i + ECG_ALGO_PACKET_SIZE <= (uint32_t)bNumRows; i += ECG_ALGO_PACKET_SIZE)
     {
-        // Pass 3 samples on a rolling basis to the local buffer
+        // Interleave the packet samples per channel
         // This assumes data is already converted from raw ADC
         // values to mV but still has baseline
-        buffer[ECG1] = dpInputCh1[i] + ABR_INPUT_BASELINE_VALUE;
-        buffer[ECG2] = dpInputCh2[i] + ABR_INPUT_BASELINE_VALUE;
-        buffer[ECG3] = dpInputCh3[i] + ABR_INPUT_BASELINE_VALUE;
+        for (uint32_t k = 0; k < ECG_ALGO_PACKET_SIZE; k++)
+        {
+            pdPacket[k * ECG_ALGO_INPUT_SIZE + ECG1] = dpInputCh1[i + k] + ABR_INPUT_BASELINE_VALUE;
+            pdPacket[k * ECG_ALGO_INPUT_SIZE + ECG2] = dpInputCh2[i + k] + ABR_INPUT_BASELINE_VALUE;
+            pdPacket[k * ECG_ALGO_INPUT_SIZE + ECG3] = dpInputCh3[i + k] + ABR_INPUT_BASELINE_VALUE;
+        }
 
-        // ECG Algorithm - preprocess and run the model
-        ret = ECGAlgo_Run(buffer, ECG_ROLLING_DATA_BUFFER_SIZE, restart);
+        // ECG Algorithm - preprocess, run the model and postprocess the packet
+        if (INPUT_ADC_COUNTS)
+        {
+            // Quantize to ADC counts as the sensor would deliver them
+            for (uint32_t k = 0; k < ECG_ALGO_PACKET_SIZE * ECG_ALGO_INPUT_SIZE; k++)
+            {
+                pnPacket[k] = (int32_t)lroundf(pdPacket[k] / ABR_INPUT_MV_PER_COUNT);
+            }
+            ret = ECGAlgo_RunBlockRaw(pnPacket, ECG_ALGO_PACKET_SIZE, &tPacketOut);
+        }
+        else
+        {
+            ret = ECGAlgo_RunBlock(pdPacket, ECG_ALGO_PACKET_SIZE, &tPacketOut);
+        }
         if (ret)
         {
-            printf("ecg_algo_run error %d\r\n", ret);
+            printf("ecg_algo_run_block error %d\r\n", ret);
             printf("Exiting...\r\n");
             return -1;
         }
 
-        // Get the algorithm outputs
-        ECGAlgo_GetOutput(algo_output, ECG_ALGO_OUTPUT_SIZE);
-
         // Write algorithm output to CSV
-        CSVW_WriteCSVSingle("e4_pred.csv", algo_output[0], 2);
-
-        // Postprocess algo output to rpeak info, reset at the end of every packet
-        ABRPostProcess_RPeak(algo_output[0], ecg_data_count);
-
-        // Increment count
-        ecg_data_count++;
+        for (uint32_t k = 0; k < ECG_ALGO_PACKET_SIZE; k++)
+        {
+            CSVW_WriteCSVSingle("e4_pred.csv", tPacketOut.pdPredictions[k], 2);
+        }
 
-        // Disable restart as we only need to do this on the first iteration
-        restart = false;
+        // Pack the BLE frame and check it decodes to the packet results
+        tBleResult.rpeak_index = tPacketOut.bRpeakIndex;
+        tBleResult.rpeak_value = tPacketOut.bRpeakValue;
+        memcpy(tBleResult.quality, tPacketOut.pbQuality, sizeof(tBleResult.quality));
+        memcpy(tBleResult.slope, tPacketOut.pbSlope, sizeof(tBleResult.slope));
+        ABRPostProcess_EncodeFrame(&tBleResult, pbBleFrame);
+        ABRPostProcess_DecodeFrame(pbBleFrame, &tBleDecoded);
+        if (memcmp(&tBleResult, &tBleDecoded, sizeof(tBleResult)) != 0)
+        {
+            printf("ble frame round trip error at packet %u\r\n", sample_count);
+            printf("Exiting...\r\n");
+            return -1;
+        }
 
-        if (ecg_data_count >= ECG_DATA_BUFFER_SIZE)
+        pdBleOuts[0] = (float)tBleDecoded.rpeak_index;
+        pdBleOuts[1] = (float)tBleDecoded.rpeak_value;
+        for (uint8_t j = 0; j < MAX_ECG; j++)
         {
-            ABRPostProcess_GetRPeak(&bRpeakMax, &bRpeakIndex);
-            pdBleOuts[0] = (float)bRpeakIndex;
-            pdBleOuts[1] = (float)bRpeakMax;
-            for (uint8_t j = 0; j < MAX_ECG; j++)
-            {
-                ABRPreProcess_GetQuality((ecg_sens_id)j, &fQClass, &bSlope);
-                pdBleOuts[2 + j] = (float)fQClass;
-                pdBleOuts[5 + j] = (float)bSlope;
-            }
+            pdBleOuts[2 + j] = (float)tBleDecoded.quality[j];
+            pdBleOuts[5 + j] = (float)tBleDecoded.slope[j];
+        }
+
+        sample_count++;
 
-            sample_count++;
-            ecg_data_count = 0;
+        // Write BLE outputs to CSV
+        CSVW_WriteCSVRow("ble.csv", pdBleOuts, 8);
 
-            // Write BLE outputs to CSV
-            CSVW_WriteCSVRow("ble.csv", pdBleOuts, 8);
+        // Write detected rpeaks (model samples) to CSV
+        if (tPacketOut.fRpeakDetected)
+        {
+            pdRpeak[0] = (float)tPacketOut.dwRpeakTimestamp;
+            pdRpeak[1] = (float)tPacketOut.dwRRInterval;
+            CSVW_WriteCSVRow("rpeaks.csv", pdRpeak, 2);
         }
     }
 
+    printf("Notch filter at %d Hz\r\n", ABRPreProcess_GetNotchFilterFreq() ? 50 : 60);
+#ifdef ECG_ALGO_PROFILE
+    ECGAlgo_DumpProfile();
+#endif
     printf("Data set complete, exiting...\r\n");
     return 0;
 }
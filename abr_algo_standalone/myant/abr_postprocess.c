@@ -11,6 +11,15 @@
 #define ABR_RPEAK_PREDICTION_MAX        3.0f
 #define ABR_RPEAK_RESOLUTION          30.0f    // 31 bits, 0 is no rpeak, so 30 bits
 
+// ABR rpeak detector definitions (see abr_sow2/preprocessors.py RpeakDetector)
+#define ABR_RPEAK_FS                  320      // Model output rate in Hz
+#define ABR_RPEAK_OUTPUT_DELAY        16       // Model output delay in samples
+#define ABR_RPEAK_REFRACTORY          ((ABR_RPEAK_FS * 60) / (2 * 220))    // Half period of 220 bpm
+
+// BLE frame definitions
+#define ABR_BLE_FIELD_5BIT            0x1F
+#define ABR_BLE_QUALITY_SHIFT         5
+
 // Structure definitions
 typedef struct
 {
@@ -19,8 +28,20 @@ typedef struct
     uint8_t max_index;
 } rpeak_pp_t;
 
+typedef struct
+{
+    uint32_t sample;         // samples since reset
+    bool     in_region;      // a region above threshold is open
+    uint32_t below;          // samples below threshold since the region opened
+    uint32_t max_sample;     // sample of the region maximum
+    float    max_value;      // region maximum
+    bool     has_last;       // a previous rpeak was reported
+    uint32_t last_timestamp; // timestamp of the previous rpeak
+} rpeak_detector_t;
+
 // Global variables definition
 static rpeak_pp_t rpeak = {0};
+static rpeak_detector_t detector = {0};
 static float rpeak_range = 0.0f;
 static float rpeak_threshold_min = 0.0f;
 
@@ -107,3 +128,130 @@ void ABRPostProcess_SetRPeak(garment_id_e nID)
 
     return;
 }
+
+/*
+ * @brief  This function runs the streaming rpeak detector on one model output
+ * @param  rpeak_output - model output of the sample
+ * @param  event - rpeak found, valid when true is returned
+ * @detail Streaming form of RpeakDetector / apply_max_peak: the outputs above
+ *         the rpeak threshold form regions, and a region is closed once
+ *         ABR_RPEAK_REFRACTORY of its samples were below the threshold. Its
+ *         maximum is then reported, ABR_RPEAK_OUTPUT_DELAY samples earlier.
+ *         The rpeaks are the same as the offline detector, reported as soon
+ *         as they are final. Heart rate in bpm is 60 * ABR_RPEAK_FS / rr_interval.
+ * @retval true if an rpeak was found
+ */
+bool ABRPostProcess_DetectRPeak(float rpeak_output, rpeak_event_t *event)
+{
+    uint32_t sample    = detector.sample++;
+    uint32_t timestamp = 0;
+
+    // 1) Track the maximum of the region above threshold
+    if (rpeak_output > rpeak_threshold_min)
+    {
+        if (!detector.in_region || (rpeak_output > detector.max_value))
+        {
+            detector.max_value  = rpeak_output;
+            detector.max_sample = sample;
+        }
+        detector.in_region = true;
+        return false;
+    }
+
+    // 2) Close the region after the refractory period below threshold
+    if (!detector.in_region || (++detector.below < ABR_RPEAK_REFRACTORY))
+    {
+        return false;
+    }
+    detector.in_region = false;
+    detector.below     = 0;
+
+    // 3) Report the region maximum, dropping rpeaks from before the start
+    if (detector.max_sample < ABR_RPEAK_OUTPUT_DELAY)
+    {
+        return false;
+    }
+    timestamp = detector.max_sample - ABR_RPEAK_OUTPUT_DELAY;
+    if (event != NULL)
+    {
+        event->timestamp   = timestamp;
+        event->rr_interval = detector.has_last ? (timestamp - detector.last_timestamp) : 0;
+        event->value       = detector.max_value;
+    }
+    detector.has_last       = true;
+    detector.last_timestamp = timestamp;
+
+    return true;
+}
+
+/*
+ * @brief  This function restarts the streaming rpeak detector, sample 0 is
+ *         the next model output
+ * @retval no return type
+ */
+void ABRPostProcess_ResetRPeakDetector(void)
+{
+    memset(&detector, 0, sizeof(detector));
+
+    return;
+}
+
+/*
+ * @brief  This function packs the packet results into a BLE frame
+ * @param  result - packet results, fields are truncated to their bit widths
+ * @param  frame - ABR_BLE_FRAME_SIZE bytes
+ * @retval no return type
+ */
+void ABRPostProcess_EncodeFrame(const abr_ble_result_t *result, uint8_t *frame)
+{
+    // 1) Check arguments
+    if (!result || !frame)
+    {
+        return;
+    }
+
+    // 2) Rpeak index and quality bits, then rpeak value
+    frame[0] = result->rpeak_index & ABR_BLE_FIELD_5BIT;
+    for (uint8_t ch = 0; ch < MAX_ECG; ch++)
+    {
+        frame[0] |= (uint8_t)((result->quality[ch] & 0x01) << (ABR_BLE_QUALITY_SHIFT + ch));
+    }
+    frame[1] = result->rpeak_value & ABR_BLE_FIELD_5BIT;
+
+    // 3) Slopes, one byte each
+    for (uint8_t ch = 0; ch < MAX_ECG; ch++)
+    {
+        frame[2 + ch] = result->slope[ch];
+    }
+
+    return;
+}
+
+/*
+ * @brief  This function unpacks a BLE frame into the packet results
+ * @detail The rpeak index and quality bits share byte 0, so the fields are
+ *         masked and shifted out into a separate abr_ble_result_t rather
+ *         than read in place from the frame.
+ * @param  frame - ABR_BLE_FRAME_SIZE bytes
+ * @param  result - packet results
+ * @retval no return type
+ */
+void ABRPostProcess_DecodeFrame(const uint8_t *frame, abr_ble_result_t *result)
+{
+    // 1) Check arguments
+    if (!result || !frame)
+    {
+        return;
+    }
+
+    // 2) Unpack fields
+    result->rpeak_index = frame[0] & ABR_BLE_FIELD_5BIT;
+    result->rpeak_value = frame[1] & ABR_BLE_FIELD_5BIT;
+    for (uint8_t ch = 0; ch < MAX_ECG; ch++)
+    {
+        result->quality[ch] = (frame[0] >> (ABR_BLE_QUALITY_SHIFT + ch)) & 0x01;
+        result->slope[ch]   = frame[2 + ch];
+    }
+
+    return;
+}
@@ -7,9 +7,36 @@
 #include <string.h>
 #include "abr_preprocess.h" // XXX - Included for garment type
 
+// Detected rpeak, timestamps in model samples (ABR_RPEAK_FS)
+typedef struct
+{
+    uint32_t timestamp;      // sample index of the rpeak, model delay removed
+    uint32_t rr_interval;    // samples since the previous rpeak, 0 for the first
+    float    value;          // model output at the rpeak
+} rpeak_event_t;
+
+// Packed BLE result frame, one per packet:
+//   byte 0: bits 0-4 rpeak index, bits 5-7 quality of ECG1..ECG3
+//   byte 1: bits 0-4 rpeak value, bits 5-7 zero
+//   byte 2..4: slope of ECG1..ECG3
+#define ABR_BLE_FRAME_SIZE 5
+
+// Unpacked BLE result
+typedef struct
+{
+    uint8_t rpeak_index;         // 0 to 24, 0 if no rpeak
+    uint8_t rpeak_value;         // 5 bit normalized rpeak
+    uint8_t quality[MAX_ECG];    // 1 bit quality class
+    uint8_t slope[MAX_ECG];
+} abr_ble_result_t;
+
 // Functions declarations
 void ABRPostProcess_RPeak(float rpeak, uint8_t count);
 void ABRPostProcess_GetRPeak(uint8_t *rpeak_max, uint8_t *rpeak_index);
 void ABRPostProcess_SetRPeak(garment_id_e nID);
+bool ABRPostProcess_DetectRPeak(float rpeak_output, rpeak_event_t *event);
+void ABRPostProcess_ResetRPeakDetector(void);
+void ABRPostProcess_EncodeFrame(const abr_ble_result_t *result, uint8_t *frame);
+void ABRPostProcess_DecodeFrame(const uint8_t *frame, abr_ble_result_t *result);
 
 #endif /* ABR_POSTPROCESS_H_ */
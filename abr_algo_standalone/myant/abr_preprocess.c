@@ -1,6 +1,5 @@
 #include "abr_preprocess.h"
 #include "csv_writers.h"
-#include "data_processing.h"
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -8,9 +7,8 @@
 #include <string.h>
 
 // Filter length definitions
-#define FILTER_LEN_QUALITY       2
 #define FILTER_LEN_ECG           3
-#define SOFTNESS_FILTER_LEN      12
+#define SOFTNESS_FILTER_LEN      12       // Softness moving average, last 12 latch outputs
 
 // Latch defitions
 #define LATCH_LIMIT_LOW_CHEST    0.15f    // Chest low limit (see ALDD)
@@ -21,17 +19,17 @@
 
 // Notch filter definitions
 #define NOTCH_FILTER_SIZE        5
-#define NOTCH_FILTER_COEFF_LEN_A 5
-#define NOTCH_FILTER_COEFF_LEN_B 5
 
-#define KMODEL_INPUT_SIZE        3
 #define SLOPE_MAX                5
 
-static float notch_out[KMODEL_INPUT_SIZE][NOTCH_FILTER_SIZE] = {0};
-static float notch_in[KMODEL_INPUT_SIZE][NOTCH_FILTER_SIZE]  = {0};
-
-static float a_notch[] = {1.0f, -1.5097772f, 2.5144414f, -1.4684226f, 0.9459779f};
-static float b_notch[] = {0.9726139f, -1.4890999f, 2.5151915f, -1.4890999f, 0.9726139f};
+// Mains detection definitions, Goertzel bins at fs = 320 Hz over 1 s blocks
+#define MAINS_BLOCK_LEN          320      // Samples per channel per decision
+#define MAINS_COEFF_60HZ         0.76536686f    // 2 * cos(2 * pi * 60 / 320)
+#define MAINS_COEFF_50HZ         1.11114047f    // 2 * cos(2 * pi * 50 / 320)
+#define MAINS_MIN_AMPLITUDE      0.01f    // mV, weaker mains is ignored
+#define MAINS_MIN_POWER          (MAINS_MIN_AMPLITUDE * MAINS_BLOCK_LEN / 2 * MAINS_MIN_AMPLITUDE * MAINS_BLOCK_LEN / 2)
+#define MAINS_SWITCH_RATIO       4.0f     // Other bin must be 6 dB stronger
+#define MAINS_SWITCH_BLOCKS      3        // Consecutive blocks before switching
 
 static const float a_notch_60hz[] = {1.0f, -1.5097772f, 2.5144414f, -1.4684226f, 0.9459779f};
 static const float b_notch_60hz[] = {0.9726139f, -1.4890999f, 2.5151915f, -1.4890999f, 0.9726139f};
@@ -39,15 +37,52 @@ static const float b_notch_60hz[] = {0.9726139f, -1.4890999f, 2.5151915f, -1.489
 static const float a_notch_50hz[] = {1.0f, -2.1918568f, 3.1457620f, -2.1318192f, 0.9459779f};
 static const float b_notch_50hz[] = {0.9726139f, -2.1618380f, 3.1465122f, -2.1618380f, 0.9726139f};
 
+// ECG bandpass: lowpass then highpass
+static const float a_ecg_lp[] = {1.0f, -1.092413f, 0.3910474f};
+static const float b_ecg_lp[] = {0.0746585f, 0.1493171f, 0.0746585f};
+
+static const float a_ecg_hp[] = {1.0f, -1.8834955f, 0.8899183f};
+static const float b_ecg_hp[] = {0.9433534f, -1.8867069f, 0.9433534f};
+
+// Quality highpass and 2Hz lowpass
+static const float a_quality_hp[] = {1.0f, -0.9902304f};
+static const float b_quality_hp[] = {0.9951152f, -0.9951152f};
+
+static const float a_quality_lp[] = {1.0f, -0.9614814f};
+static const float b_quality_lp[] = {0.0192592f, 0.0192592f};
+
+// Filter histories of one channel, cleared on restart. Index 0 holds the most
+// recent past sample.
 typedef struct
 {
+    float    notch_x[NOTCH_FILTER_SIZE - 1];
+    float    notch_y[NOTCH_FILTER_SIZE - 1];
+    float    ecg_lp_x[FILTER_LEN_ECG - 1];
+    float    ecg_lp_y[FILTER_LEN_ECG - 1];
+    float    ecg_hp_x[FILTER_LEN_ECG - 1];
+    float    ecg_hp_y[FILTER_LEN_ECG - 1];
+    float    quality_hp_x;
+    float    quality_hp_y;
+    float    quality_lp_x;
+    float    quality_lp_y;
+    float    prev_ecg;
+    float    max_diff;
+    uint8_t  softness_window[SOFTNESS_FILTER_LEN];
+    uint16_t softness_index;
+    uint16_t softness_sum;
+} filter_state_t;
+
+// Pre-processing state and quality of one channel
+typedef struct
+{
+    filter_state_t  filter;
+    uint8_t         latch_q;
     uint8_t         slope;
-    float           max_diff;
     quality_class_e q_class;
     bool            noise_detect;
     uint8_t         latch;
     float           filter_softness;
-} quality_t;
+} channel_state_t;
 
 typedef enum
 {
@@ -55,190 +90,227 @@ typedef enum
     FQ_50HZ,
 } notch_fq;
 
+// Streaming 50/60 Hz detector on the raw ECG of all channels
+typedef struct
+{
+    bool     enabled;
+    float    s60[MAX_ECG][2];   // Goertzel states s[n-1], s[n-2] at 60 Hz
+    float    s50[MAX_ECG][2];   // Goertzel states s[n-1], s[n-2] at 50 Hz
+    uint16_t count;             // Frames in the current block
+    uint8_t  votes;             // Consecutive blocks favouring the other bin
+} mains_detector_t;
+
 // Global variables
-static notch_fq  notch_cnf_fq_flag     = FQ_60HZ;
-static quality_t quality_info[MAX_ECG] = {0};
-static bool      filter_restart        = false;
+static notch_fq        notch_cnf_fq_flag        = FQ_60HZ;
+static const float    *a_notch                  = a_notch_60hz;
+static const float    *b_notch                  = b_notch_60hz;
+static channel_state_t channel_state[MAX_ECG]   = {0};
+static bool            filter_restart           = false;
+static mains_detector_t mains                   = {0};
 
 static float     dLatchLimitLow  = 0.0f;
 static float     dLatchLimitHigh = 0.0f;
 
-static float   abr_ecg_process(float sample, ecg_sens_id ecg_id, bool restart);
-static uint8_t latch_sigmoid(float sample, ecg_sens_id ecg_id);
-static float softness_filter(float sample, uint8_t ecg_ch, bool restart);
-static void abr_quality_slope(float sample, ecg_sens_id ecg_id, float *sample_diff, bool restart);
-static void abr_quality_process(float x, float sample, ecg_sens_id ecg_id, uint8_t *latch_out, float *filter_softness, bool *noise_detect, bool restart);
-
-/*
- * @brief  This function applies lowpass and high pass to the ecg signal.
- * @param  sample - sample data from channel 1,2 or 3 depending upon the ecg id
- * @param  ecg_id - Channel id is used to keep track of the input data and output data.
- * @retval It returns filtered value to get_preprocess_out function.
- */
-static float abr_ecg_process(float sample, ecg_sens_id ecg_id, bool restart)
-{
-    float output[] = {0, 0, 0};
-
-    static const float ah[] = {1.0f, -1.8834955f, 0.8899183f};
-    static const float bh[] = {0.9433534f, -1.8867069f, 0.9433534f};
-
-    static const float al[] = {1.0f, -1.092413f, 0.3910474f};
-    static const float bl[] = {0.0746585f, 0.1493171f, 0.0746585f};
-
-    static float input_ecg[MAX_ECG][FILTER_LEN_ECG];
-    static float output_temp[MAX_ECG][FILTER_LEN_ECG];
-
-    static float input_temp[MAX_ECG][FILTER_LEN_ECG];
-    static float output_ecg[MAX_ECG][FILTER_LEN_ECG];
-
-    output[ecg_id] = digital_filter((float)sample, input_ecg[ecg_id], output_temp[ecg_id], al, bl, 3, 3, FILTER_LEN_ECG, restart, 0);
-    output[ecg_id] = digital_filter(output[ecg_id], input_temp[ecg_id], output_ecg[ecg_id], ah, bh, 3, 3, FILTER_LEN_ECG, restart, 0);
-
-    return output[ecg_id];
-}
+static float abr_preprocess_sample(channel_state_t *ch, float x, bool restart);
+static void mains_detect(float x, uint8_t ecg_ch, bool restart);
 
 /*
- * @brief  This function find the slope of ecg sample.
- * @param  sample - sample data from channel 1,2 or 3 depending upon the ecg id
- * @param  ecg_id - Channel id is used to keep track of the input data and output data.
- * @param  sample_diff- is a pointer used to store the max_diff between 2 ecg sample
- * @retval Update the maximum diff between 2 ecg samples.
+ * @brief  This function runs the 50 Hz and 60 Hz Goertzel bins on a raw ECG
+ *         sample and, once per block, switches the notch filter to the
+ *         stronger mains frequency.
+ * @param  x - ECG sample in mV
+ * @param  ecg_ch - Channel id is used to keep track of the input data and output data.
+ * @param  restart - clear the detector first
+ * @detail The bin powers of all channels are summed over MAINS_BLOCK_LEN
+ *         samples, an integer number of cycles of both frequencies so DC does
+ *         not leak in. The notch switches only after the other bin is
+ *         MAINS_SWITCH_RATIO stronger and above MAINS_MIN_POWER for
+ *         MAINS_SWITCH_BLOCKS blocks in a row.
+ * @retval no return type
  */
-static void abr_quality_slope(float sample, ecg_sens_id ecg_id, float *sample_diff, bool restart)
+static void mains_detect(float x, uint8_t ecg_ch, bool restart)
 {
-    static float temp_slope[] = {0, 0, 0};
-    float        max          = 0;
+    float *s60    = mains.s60[ecg_ch];
+    float *s50    = mains.s50[ecg_ch];
+    float s       = 0;
+    float power60 = 0;
+    float power50 = 0;
+    float current = 0;
+    float other   = 0;
 
     if (restart)
     {
-        memset(temp_slope, 0, sizeof(temp_slope));
-        *sample_diff = 0;
+        s60[0] = s60[1] = 0.0f;
+        s50[0] = s50[1] = 0.0f;
+        if (ecg_ch == ECG1)
+        {
+            mains.count = 0;
+            mains.votes = 0;
+        }
     }
 
-    max = fabs(temp_slope[ecg_id] - sample);
+    // 1) Goertzel recursions, one MAC per bin
+    s      = x + MAINS_COEFF_60HZ * s60[0] - s60[1];
+    s60[1] = s60[0];
+    s60[0] = s;
+    s      = x + MAINS_COEFF_50HZ * s50[0] - s50[1];
+    s50[1] = s50[0];
+    s50[0] = s;
+
+    // 2) Count frames, decide at the end of a block
+    if (ecg_ch != MAX_ECG - 1)
+    {
+        return;
+    }
+    if (++mains.count < MAINS_BLOCK_LEN)
+    {
+        return;
+    }
 
-    if (max > *sample_diff)
+    for (uint8_t ch = 0; ch < MAX_ECG; ch++)
+    {
+        s60 = mains.s60[ch];
+        s50 = mains.s50[ch];
+        power60 += s60[0] * s60[0] + s60[1] * s60[1] - MAINS_COEFF_60HZ * s60[0] * s60[1];
+        power50 += s50[0] * s50[0] + s50[1] * s50[1] - MAINS_COEFF_50HZ * s50[0] * s50[1];
+    }
+    memset(mains.s60, 0, sizeof(mains.s60));
+    memset(mains.s50, 0, sizeof(mains.s50));
+    mains.count = 0;
+
+    // 3) Switch the notch with hysteresis
+    current = (notch_cnf_fq_flag == FQ_50HZ) ? power50 : power60;
+    other   = (notch_cnf_fq_flag == FQ_50HZ) ? power60 : power50;
+    if ((other > MAINS_MIN_POWER) && (other > MAINS_SWITCH_RATIO * current))
+    {
+        mains.votes++;
+    }
+    else
     {
-        *sample_diff = max;
+        mains.votes = 0;
     }
 
-    if (*sample_diff > SLOPE_MAX)
+    if (mains.votes >= MAINS_SWITCH_BLOCKS)
     {
-        *sample_diff = SLOPE_MAX;
+        ABRPreProcess_SetNotchFilterCoeffient(notch_cnf_fq_flag == FQ_60HZ);
+        mains.votes = 0;
     }
 
-    temp_slope[ecg_id] = sample;
+    return;
 }
 
 /*
- * @brief  This function applies lowpass and high pass to the quality signal,
- *         detect the noise in the signal and find filter_softness.
- * @param  sample - sample data from channel 1,2 or 3 depending upon the ecg id
- * @param  ecg_id - Channel id is used to keep track of the input data and output data.
- * @retval Updates, noise_detection flag, latch_out and filter_softness.
+ * @brief  This function runs the whole pre-processing of one ECG sample:
+ *         notch, bandpass, slope, quality highpass/lowpass, latch and
+ *         softness filter, over the state block of its channel.
+ * @param  ch - state of the channel the sample belongs to
+ * @param  x - ECG sample in mV, baseline removed
+ * @param  restart - clear the channel filter histories first
+ * @detail Every stage is computed in the same order as the direct form
+ *         digital_filter, so the output matches the per-stage implementation.
+ * @retval It returns the processed ECG in the units set by the output scale.
  */
-static void abr_quality_process(float x, float sample, ecg_sens_id ecg_id, uint8_t *latch_out, float *filter_softness, bool *noise_detect, bool restart)
+static float abr_preprocess_sample(channel_state_t *ch, float x, bool restart)
 {
-    static const float ah[] = {1.0f, -0.9902304f};
-    static const float bh[] = {0.9951152f, -0.9951152f};
-
-    static const float al[] = {1.0f, -0.9614814f};
-    static const float bl[] = {0.0192592f, 0.0192592f};
-
-    static float       input_lp[MAX_ECG][FILTER_LEN_QUALITY];
-    static float       output_lp[MAX_ECG][FILTER_LEN_QUALITY];
-
-    static float       input_hp[MAX_ECG][FILTER_LEN_QUALITY];
-    static float       output_hp[MAX_ECG][FILTER_LEN_QUALITY];
-
-    static float       quality[MAX_ECG]      = {0, 0, 0};
-    float              temp_quality[MAX_ECG] = {0, 0, 0};
-    float              quality_class_temp    = 0;
-
-    temp_quality[ecg_id] = digital_filter(x, input_hp[ecg_id], output_hp[ecg_id], ah, bh, 2, 2, FILTER_LEN_QUALITY, restart, 0);
-
-    // calculate abs value
-    temp_quality[ecg_id] = temp_quality[ecg_id] - sample;
-    temp_quality[ecg_id] = (float)fabs(temp_quality[ecg_id]);
-
-    // lowpass 2Hz
-    quality[ecg_id] = digital_filter(temp_quality[ecg_id], input_lp[ecg_id], output_lp[ecg_id], al, bl, 2, 2, FILTER_LEN_QUALITY, restart, 0);
-    
-    // Latch
-    *latch_out = 1 - latch_sigmoid(quality[ecg_id], ecg_id);
+    filter_state_t *f = &ch->filter;
+    float notch       = 0;
+    float lowpass     = 0;
+    float ecg         = 0;
+    float diff        = 0;
+    float highpass    = 0;
+    float quality     = 0;
+    float softness    = 0;
 
-    // Softness filter
-    *filter_softness = softness_filter(*latch_out, ecg_id, restart);
-
-    quality_class_temp = 1 - *filter_softness;
-    if ((int)quality_class_temp != 0)
+    if (restart)
     {
-        *noise_detect = true;
-    }
-}
+        memset(f, 0, sizeof(*f));
 
-/*
- * @brief  This function uses filtered quality signal to produce latch output
- * @param  quality - quality data
- * @detail The filter quality value is checked with the upper and lower threshold values. 
- *         Depending upon the filter quality the latch is updated.
- * @retval It returns the latch
- */
-static uint8_t latch_sigmoid(float quality, ecg_sens_id ecg_id)
-{
-    static uint8_t latch_q[MAX_ECG] = {0, 0, 0};
+        // The softness window starts full of ones: this is the warm-up ramp
+        // (L - 1 - n) / L added while the first L latch outputs arrive
+        memset(f->softness_window, 1, sizeof(f->softness_window));
+        f->softness_sum = SOFTNESS_FILTER_LEN;
+    }
 
-    if (quality > dLatchLimitHigh)
+    // Notch
+    notch = b_notch[0] * x + b_notch[1] * f->notch_x[0] + b_notch[2] * f->notch_x[1] + b_notch[3] * f->notch_x[2] + b_notch[4] * f->notch_x[3]
+          - a_notch[1] * f->notch_y[0] - a_notch[2] * f->notch_y[1] - a_notch[3] * f->notch_y[2] - a_notch[4] * f->notch_y[3];
+    f->notch_x[3] = f->notch_x[2];
+    f->notch_x[2] = f->notch_x[1];
+    f->notch_x[1] = f->notch_x[0];
+    f->notch_x[0] = x;
+    f->notch_y[3] = f->notch_y[2];
+    f->notch_y[2] = f->notch_y[1];
+    f->notch_y[1] = f->notch_y[0];
+    f->notch_y[0] = notch;
+
+    // Bandpass
+    lowpass = b_ecg_lp[0] * notch + b_ecg_lp[1] * f->ecg_lp_x[0] + b_ecg_lp[2] * f->ecg_lp_x[1]
+            - a_ecg_lp[1] * f->ecg_lp_y[0] - a_ecg_lp[2] * f->ecg_lp_y[1];
+    f->ecg_lp_x[1] = f->ecg_lp_x[0];
+    f->ecg_lp_x[0] = notch;
+    f->ecg_lp_y[1] = f->ecg_lp_y[0];
+    f->ecg_lp_y[0] = lowpass;
+
+    ecg = b_ecg_hp[0] * lowpass + b_ecg_hp[1] * f->ecg_hp_x[0] + b_ecg_hp[2] * f->ecg_hp_x[1]
+        - a_ecg_hp[1] * f->ecg_hp_y[0] - a_ecg_hp[2] * f->ecg_hp_y[1];
+    f->ecg_hp_x[1] = f->ecg_hp_x[0];
+    f->ecg_hp_x[0] = lowpass;
+    f->ecg_hp_y[1] = f->ecg_hp_y[0];
+    f->ecg_hp_y[0] = ecg;
+
+    // Slope, maximum difference between 2 samples since the last packet
+    diff = fabsf(f->prev_ecg - ecg);
+    if (diff > f->max_diff)
     {
-        latch_q[ecg_id] = 1;
+        f->max_diff = diff;
     }
-    else if (quality < dLatchLimitLow)
+    if (f->max_diff > SLOPE_MAX)
     {
-        latch_q[ecg_id] = 0;
+        f->max_diff = SLOPE_MAX;
     }
+    f->prev_ecg = ecg;
+    ch->slope   = (uint8_t)((f->max_diff / 5) * 200);
 
-    return latch_q[ecg_id];
-}
-
-/*
- * @brief  This function is used to give average of last 12 samples
- * @param  sample - sample data from channel 1,2 or 3 depending upon the ecg id
- * @detail The aim of this function is to provide moving average of quality
- * @retval It returns the moving average of quality signal
- */
-static float softness_filter(float sample, uint8_t ecg_ch, bool restart)
-{
-    static float   latest_sample[MAX_ECG][SOFTNESS_FILTER_LEN] = {0};
-    static uint8_t counter[MAX_ECG]                            = {0, 0, 0};
+    // Quality: highpass of the input against the filtered ECG, then lowpass 2Hz
+    highpass = b_quality_hp[0] * x + b_quality_hp[1] * f->quality_hp_x - a_quality_hp[1] * f->quality_hp_y;
+    f->quality_hp_x = x;
+    f->quality_hp_y = highpass;
 
-    const float intl_input[SOFTNESS_FILTER_LEN - 1] = {0.916666f, 0.833333f, 0.75f, 0.666666f, 0.583333f, 0.5f, 0.416666f, 0.333333f, 0.25f, 0.166666f, 0.083333f};
-    float avg_out = 0;
+    diff    = fabsf(highpass - ecg);
+    quality = b_quality_lp[0] * diff + b_quality_lp[1] * f->quality_lp_x - a_quality_lp[1] * f->quality_lp_y;
+    f->quality_lp_x = diff;
+    f->quality_lp_y = quality;
 
-    if (restart)
+    // Latch
+    if (quality > dLatchLimitHigh)
     {
-        memset(latest_sample, 0, sizeof(latest_sample));
-        memset(counter, 0, sizeof(counter));
+        ch->latch_q = 1;
     }
-
-    latest_sample[ecg_ch][SOFTNESS_FILTER_LEN - 1] = sample;
-
-    for (uint8_t i = 0; i < SOFTNESS_FILTER_LEN; i++)
+    else if (quality < dLatchLimitLow)
     {
-        avg_out += latest_sample[ecg_ch][i] / SOFTNESS_FILTER_LEN;
+        ch->latch_q = 0;
     }
-
-    if (counter[ecg_ch] < SOFTNESS_FILTER_LEN)
+    ch->latch = 1 - ch->latch_q;
+
+    // Softness, average of the last SOFTNESS_FILTER_LEN latch outputs kept as
+    // a running sum over a ring buffer
+    f->softness_sum += ch->latch;
+    f->softness_sum -= f->softness_window[f->softness_index];
+    f->softness_window[f->softness_index] = ch->latch;
+    if (++f->softness_index == SOFTNESS_FILTER_LEN)
     {
-        avg_out += intl_input[counter[ecg_ch]];
-        counter[ecg_ch]++;
+        f->softness_index = 0;
     }
+    softness            = f->softness_sum * (1.0f / SOFTNESS_FILTER_LEN);
+    ch->filter_softness = softness;
 
-    for (uint8_t j = 1; j < SOFTNESS_FILTER_LEN; j++)
+    if ((int)(1 - softness) != 0)
     {
-        latest_sample[ecg_ch][j - 1] = latest_sample[ecg_ch][j];
+        ch->noise_detect = true;
     }
 
-    return avg_out;
+    // Processed ECG
+    return ecg * softness;
 }
 
 /*
@@ -249,21 +321,23 @@ static float softness_filter(float sample, uint8_t ecg_ch, bool restart)
  */
 void ABRPreProcess_GetQuality(ecg_sens_id ecg_id, uint8_t *q_class, uint8_t *slope)
 {
-    if (quality_info[ecg_id].noise_detect == true)
+    channel_state_t *ch = &channel_state[ecg_id];
+
+    if (ch->noise_detect == true)
     {
-        quality_info[ecg_id].q_class = Q_NOISY;
+        ch->q_class = Q_NOISY;
     }
     else
     {
-        quality_info[ecg_id].q_class = Q_CLEAN;
+        ch->q_class = Q_CLEAN;
     }
 
-    *q_class = quality_info[ecg_id].q_class - 1;
-    *slope   = (uint8_t)quality_info[ecg_id].slope;
+    *q_class = ch->q_class - 1;
+    *slope   = ch->slope;
 
-    quality_info[ecg_id].slope        = 0.0f;
-    quality_info[ecg_id].noise_detect = false;
-    quality_info[ecg_id].max_diff     = 0.0f;
+    ch->slope           = 0;
+    ch->noise_detect    = false;
+    ch->filter.max_diff = 0.0f;
 }
 
 /*
@@ -279,17 +353,41 @@ void ABRPreProcess_SetNotchFilterCoeffient(bool freq_update)
     if (freq_update)
     {
         notch_cnf_fq_flag = FQ_50HZ;
-        memcpy(a_notch, a_notch_50hz, sizeof(a_notch));
-        memcpy(b_notch, b_notch_50hz, sizeof(b_notch));
+        a_notch           = a_notch_50hz;
+        b_notch           = b_notch_50hz;
     }
     else
     {
         notch_cnf_fq_flag = FQ_60HZ;
-        memcpy(a_notch, a_notch_60hz, sizeof(a_notch));
-        memcpy(b_notch, b_notch_60hz, sizeof(b_notch));
+        a_notch           = a_notch_60hz;
+        b_notch           = b_notch_60hz;
     }
 }
 
+/*
+ * @brief  This function enables the automatic 50/60 Hz mains detection
+ * @param  enable - true to switch the notch filter to the detected mains
+ *         frequency, false to keep the one set by
+ *         ABRPreProcess_SetNotchFilterCoeffient
+ * @retval no return type
+ */
+void ABRPreProcess_SetMainsDetection(bool enable)
+{
+    memset(&mains, 0, sizeof(mains));
+    mains.enabled = enable;
+
+    return;
+}
+
+/*
+ * @brief  This function returns the notch filter frequency in use
+ * @retval true for 50 Hz, false for 60 Hz
+ */
+bool ABRPreProcess_GetNotchFilterFreq(void)
+{
+    return (notch_cnf_fq_flag == FQ_50HZ);
+}
+
 /*
  * @brief  This function takes ecg data in mV and provides the quality of the
  *         signal and prepocess the ecg values for the ABR2.0 model. This
@@ -303,41 +401,25 @@ void ABRPreProcess_SetNotchFilterCoeffient(bool freq_update)
  */
 float ABRPreProcess_GetOutput(float x, uint8_t ecg_ch, bool restart, garment_id_e gar_id)
 {
-    float filtered_ecg[MAX_ECG]  = {0, 0, 0};
-    float processed_ecg[MAX_ECG] = {0, 0, 0};
-    float temp_ecg[MAX_ECG]      = {0, 0, 0};
-
-    // 1) Reset filter if requested
+    // 1) Reset notch filter if requested
     if (filter_restart == true)
     {
-        memset(notch_in, 0, sizeof(notch_in));
-        memset(notch_out, 0, sizeof(notch_out));
+        for (uint8_t i = 0; i < MAX_ECG; i++)
+        {
+            memset(channel_state[i].filter.notch_x, 0, sizeof(channel_state[i].filter.notch_x));
+            memset(channel_state[i].filter.notch_y, 0, sizeof(channel_state[i].filter.notch_y));
+        }
         filter_restart = false;
     }
 
-    // 2) Apply digital filter
-    temp_ecg[ecg_ch] = digital_filter(x, notch_in[ecg_ch], notch_out[ecg_ch], a_notch, b_notch, NOTCH_FILTER_COEFF_LEN_A, NOTCH_FILTER_COEFF_LEN_B, NOTCH_FILTER_SIZE, restart, 0);
-    
-    // 3) Apply bandpass filter
-    filtered_ecg[ecg_ch] = abr_ecg_process(temp_ecg[ecg_ch], (ecg_sens_id)ecg_ch, restart);
-
-    // 4) Calculate quality slope and normalize
-    abr_quality_slope(filtered_ecg[ecg_ch], (ecg_sens_id)ecg_ch, &quality_info[ecg_ch].max_diff, restart);
-    quality_info[ecg_ch].slope = (uint8_t)((quality_info[ecg_ch].max_diff / 5) * 200);
-
-    // 5) Process Quality
-    abr_quality_process(x,
-                        filtered_ecg[ecg_ch],
-                        (ecg_sens_id)ecg_ch,
-                        &quality_info[ecg_ch].latch,
-                        &quality_info[ecg_ch].filter_softness,
-                        &quality_info[ecg_ch].noise_detect,
-                        restart);
-
-    // 6) Generate processed ECG output
-    processed_ecg[ecg_ch] = (filtered_ecg[ecg_ch] * quality_info[ecg_ch].filter_softness);
-    
-    return processed_ecg[ecg_ch];
+    // 2) Track the mains frequency
+    if (mains.enabled)
+    {
+        mains_detect(x, ecg_ch, restart);
+    }
+
+    // 3) Filter, update quality and generate processed ECG output
+    return abr_preprocess_sample(&channel_state[ecg_ch], x, restart);
 }
 
 /*
@@ -1,20 +1,161 @@
+#include <stdio.h>
 #include <string.h>
 #include "abr_preprocess.h"
 #include "abr_postprocess.h"
+#include "sow2_preprocess.h"
 #include "ecg_algo.h"
 #include "custom_chest.h"
 #include "custom_waist.h"
-#include "model.h"
 
 //Global variables definition
 constexpr int kModelInputSize = ECG_ALGO_INPUT_SIZE;       // Number of model input values
 constexpr int kOutputSize     = ECG_ALGO_OUTPUT_SIZE;      // Number of model output values
 constexpr int kStateInputSize = ECG_ALGO_STATE_INPUT_SIZE; // Total number of model states
 
+// Model operations of one garment model
+typedef struct
+{
+    int (*setup)(int input_size, int state_size, int output_size);
+    float (*get_input_inv_scale)(void);
+    void (*set_scaled_inputs)(const float *scaled_vals);
+    void (*set_states)(float *state_vals);
+    int (*inference)(void);
+    void (*get_states)(float *state_vals);
+    void (*get_outputs)(float *output_vals);
+} abr_model_ops_t;
+
+static const abr_model_ops_t tChestModel =
+{
+    custom_chest_setup,
+    custom_chest_get_input_inv_scale,
+    custom_chest_set_scaled_inputs,
+    custom_chest_set_states,
+    custom_chest_inference,
+    custom_chest_get_states,
+    custom_chest_get_outputs,
+};
+
+static const abr_model_ops_t tWaistModel =
+{
+    custom_waist_setup,
+    custom_waist_get_input_inv_scale,
+    custom_waist_set_scaled_inputs,
+    custom_waist_set_states,
+    custom_waist_inference,
+    custom_waist_get_states,
+    custom_waist_get_outputs,
+};
+
+// Model used by each garment
+static const abr_model_ops_t *const ppGarmentModels[MAX_GARMENTS] =
+{
+    &tWaistModel,    // GARMENT_UNDERWEAR
+    &tChestModel,    // GARMENT_BRA_TANK
+    &tChestModel,    // GARMENT_CHEST_BAND
+    &tChestModel,    // GARMENT_BRALETTE
+    &tChestModel,    // GARMENT_PEDIATRIC_BAND
+};
+
+// Operations of one ECG pre-processor
+typedef struct
+{
+    float (*get_output)(float x, uint8_t ecg_ch, bool restart, garment_id_e gar_id);
+    void (*get_quality)(ecg_sens_id ecg_id, uint8_t *q_class, uint8_t *slope);
+    void (*set_limits)(garment_id_e nID);
+} ecg_preproc_ops_t;
+
+static const ecg_preproc_ops_t tPreprocessors[MAX_ECG_PREPROC] =
+{
+    // ECG_PREPROC_ABR
+    {
+        ABRPreProcess_GetOutput,
+        ABRPreProcess_GetQuality,
+        ABRPreProcess_SetLatchLimits,
+    },
+    // ECG_PREPROC_SOW2
+    {
+        SOW2PreProcess_GetOutput,
+        SOW2PreProcess_GetQuality,
+        SOW2PreProcess_SetLimits,
+    },
+};
+
+#ifdef ECG_ALGO_PROFILE
+// Latency histogram of one pipeline stage, in timer ticks
+typedef struct
+{
+    uint32_t pdwBins[ECG_ALGO_PROFILE_BINS];
+    uint32_t dwCount;
+    uint32_t dwMax;
+    uint32_t dwOverBudget;
+    uint64_t qwTotal;
+} ecg_stage_profile_t;
+
+static const char *const ppStageNames[MAX_ECG_STAGE] =
+{
+    "preprocess",
+    "quantize",
+    "inference",
+    "dequantize",
+    "postprocess",
+    "sample",
+};
+
+static ecg_stage_profile_t tProfile[MAX_ECG_STAGE]  = {0};
+static ecg_algo_timer_t    fnProfileTimer          = NULL;
+static uint32_t            dwProfileTicksPerSecond = 0;
+static uint32_t            dwProfileBudget         = 0;
+
+/*
+ * @brief  This function records the latency of a stage
+ * @param  nStage - stage ID
+ * @param  dwStart - timer value at the start of the stage
+ * @retval timer value at the end of the stage
+ */
+static uint32_t ecg_profile_record(ecg_stage_id_e nStage, uint32_t dwStart)
+{
+    ecg_stage_profile_t *pStage = &tProfile[nStage];
+    uint32_t dwNow   = fnProfileTimer();
+    uint32_t dwTicks = dwNow - dwStart;   // wraps correctly for a free running timer
+    uint8_t  bBin    = 0;
+
+    // 1) Bin is the bit length of the latency
+    for (uint32_t dwValue = dwTicks; dwValue != 0; dwValue >>= 1)
+    {
+        bBin++;
+    }
+
+    // 2) Update the stage statistics
+    pStage->pdwBins[bBin]++;
+    pStage->dwCount++;
+    pStage->qwTotal += dwTicks;
+    if (dwTicks > pStage->dwMax)
+    {
+        pStage->dwMax = dwTicks;
+    }
+    if (dwTicks > dwProfileBudget)
+    {
+        pStage->dwOverBudget++;
+    }
+
+    return dwNow;
+}
+
+#define ECG_PROFILE_START(dwMark)          uint32_t dwMark = (fnProfileTimer != NULL) ? fnProfileTimer() : 0
+#define ECG_PROFILE_STAGE(nStage, dwMark)  do { if (fnProfileTimer != NULL) { dwMark = ecg_profile_record(nStage, dwMark); } } while (0)
+#else
+#define ECG_PROFILE_START(dwMark)
+#define ECG_PROFILE_STAGE(nStage, dwMark)
+#endif
+
 static bool fInitDone = false;
+static bool fRestartPending = true;
 static float pdStates[kStateInputSize] = {0};
-const unsigned char *pModelBuffer = g_model_waist;
+static const abr_model_ops_t *pModel = &tWaistModel;
+static const ecg_preproc_ops_t *pPreproc = &tPreprocessors[ECG_PREPROC_ABR];
 static garment_id_e nGarmentID = GARMENT_UNDERWEAR;
+static uint8_t bRpeakValue = 0;    // last packet rpeak, kept when none is valid
+static uint8_t bRpeakIndex = 0;
 
 void ECGAlgo_SetGarmentID(garment_id_e nID)
 {
@@ -24,15 +165,8 @@ void ECGAlgo_SetGarmentID(garment_id_e nID)
         return;
     }
 
-    // 2) Set model
-    if (nID == GARMENT_UNDERWEAR)
-    {
-        pModelBuffer = g_model_waist;
-    }
-    else
-    {
-        pModelBuffer = g_model_chest;
-    }
+    // 2) Bind the model operations
+    pModel = ppGarmentModels[nID];
 
     // 3) Store garment ID
     nGarmentID = nID;
@@ -40,8 +174,29 @@ void ECGAlgo_SetGarmentID(garment_id_e nID)
     // 4) Update rpeak threshold + range in post processor
     ABRPostProcess_SetRPeak(nID);
 
-    // 5) Update Quality Latch Limits in abr_preprocess.c
-    ABRPreProcess_SetLatchLimits(nID);
+    // 5) Update Quality Latch Limits in the pre-processor
+    pPreproc->set_limits(nID);
+
+    return;
+}
+
+/*
+ * @brief  This function selects the ECG pre-processor, call before
+ *         ECGAlgo_Init. The default is ECG_PREPROC_ABR.
+ * @param  nID - pre-processor ID
+ * @retval no return type
+ */
+void ECGAlgo_SetPreprocessor(ecg_preproc_id_e nID)
+{
+    // 1) Check arguements
+    if (nID >= MAX_ECG_PREPROC)
+    {
+        return;
+    }
+
+    // 2) Bind the pre-processor and configure it for the current garment
+    pPreproc = &tPreprocessors[nID];
+    pPreproc->set_limits(nGarmentID);
 
     return;
 }
@@ -49,20 +204,14 @@ void ECGAlgo_SetGarmentID(garment_id_e nID)
 void ECGAlgo_Init(void)
 {
     // 1) Clear pdStates 
-    memset(pdStates, 0, kStateInputSize);
+    memset(pdStates, 0, sizeof(pdStates));
 
-    // 2) Based on garment type, set-up the appropriate model
-    if (nGarmentID  == GARMENT_UNDERWEAR)
-    {
-        custom_waist_setup(kModelInputSize, kStateInputSize, kOutputSize);
-    }
-    else
-    {
-        custom_chest_setup(kModelInputSize, kStateInputSize, kOutputSize);
-    }
+    // 2) Set-up the model bound to the garment
+    pModel->setup(kModelInputSize, kStateInputSize, kOutputSize);
 
-    // 3) Mark as initialized
+    // 3) Mark as initialized, the first block restarts the filters
     fInitDone = true;
+    fRestartPending = true;
 
     return;
 }
@@ -73,6 +222,7 @@ bool ECGAlgo_Run(float *pdData, uint8_t bChannelCount, bool fRestart)
     float pdInput[kModelInputSize] = {0};
     float pdPreprocessorInput[kModelInputSize] = {0};
     float dTemp = 0;
+    float dInputInvScale = pModel->get_input_inv_scale();
 
     // 1) Check arguments
     if (bChannelCount != kModelInputSize)
@@ -89,7 +239,7 @@ bool ECGAlgo_Run(float *pdData, uint8_t bChannelCount, bool fRestart)
     // 3) If fRestart was set, clear pdStates
     if (fRestart)
     {
-        memset(pdStates, 0, kStateInputSize);
+        memset(pdStates, 0, sizeof(pdStates));
     }
 
     // 4) Extract data for pre-processing
@@ -98,6 +248,7 @@ bool ECGAlgo_Run(float *pdData, uint8_t bChannelCount, bool fRestart)
     pdInput[2] = pdData[2];
 
     // 5) Pre-process inputs
+    ECG_PROFILE_START(dwMark);
     for (uint8_t ecg_ch = 0; ecg_ch < kModelInputSize; ecg_ch++)
     {
         dTemp = pdInput[ecg_ch];
@@ -106,25 +257,23 @@ bool ECGAlgo_Run(float *pdData, uint8_t bChannelCount, bool fRestart)
         dTemp -= ABR_INPUT_BASELINE_VALUE;
 
         // preprocessor:
-        dTemp = ABRPreProcess_GetOutput(dTemp, ecg_ch, fRestart, nGarmentID);
+        dTemp = pPreproc->get_output(dTemp, ecg_ch, fRestart, nGarmentID);
 
         pdPreprocessorInput[ecg_ch] = (float)dTemp;
     }
+    ECG_PROFILE_STAGE(ECG_STAGE_PREPROCESS, dwMark);
 
 
-    // 6) Set inputs, pdStates based on garment type selected
-    if(nGarmentID  == GARMENT_UNDERWEAR)
-    {
-        custom_waist_set_inputs(pdPreprocessorInput);
-        custom_waist_set_states(pdStates);
-        ret = custom_waist_inference();
-    } 
-    else
+    // 6) Scale mV to model input units, set inputs, pdStates and run the bound model
+    for (uint8_t ecg_ch = 0; ecg_ch < kModelInputSize; ecg_ch++)
     {
-        custom_chest_set_inputs(pdPreprocessorInput);
-        custom_chest_set_states(pdStates);
-        ret = custom_chest_inference();
+        pdPreprocessorInput[ecg_ch] *= dInputInvScale;
     }
+    pModel->set_scaled_inputs(pdPreprocessorInput);
+    pModel->set_states(pdStates);
+    ECG_PROFILE_STAGE(ECG_STAGE_QUANTIZE, dwMark);
+    ret = pModel->inference();
+    ECG_PROFILE_STAGE(ECG_STAGE_INFERENCE, dwMark);
 
     return (ret==1);
 }
@@ -144,16 +293,247 @@ void ECGAlgo_GetOutput(float *pdOutputs, uint8_t bLength)
     }
 
     // 3) Get post inference pdStates and outputs
-    if (nGarmentID  == GARMENT_UNDERWEAR)
+    ECG_PROFILE_START(dwMark);
+    pModel->get_states(pdStates);
+    pModel->get_outputs(pdOutputs);
+    ECG_PROFILE_STAGE(ECG_STAGE_DEQUANTIZE, dwMark);
+
+    return;
+}
+
+/*
+ * @brief  This function converts a mV sample with baseline to mV without
+ * @retval sample in mV, baseline removed
+ */
+static inline float input_to_mv(float dSample)
+{
+    return dSample - ABR_INPUT_BASELINE_VALUE;
+}
+
+/*
+ * @brief  This function converts a raw ADC sample to mV without baseline,
+ *         removing the baseline in counts first so it is exact
+ * @retval sample in mV, baseline removed
+ */
+static inline float input_to_mv(int32_t nCounts)
+{
+    return (float)(nCounts - ABR_INPUT_BASELINE_COUNTS) * ABR_INPUT_MV_PER_COUNT;
+}
+
+/*
+ * @brief  This function runs the ECG algorithm on a whole BLE packet of
+ *         samples of type T, converted by input_to_mv.
+ * @retval true on error
+ */
+template <typename T>
+static bool run_block(const T *pInterleaved, size_t nSamples, ecg_packet_out_t *pOut)
+{
+    const abr_model_ops_t   *pOps                                 = pModel;
+    const ecg_preproc_ops_t *pPre                                 = pPreproc;
+    const float             dInputInvScale                       = pOps->get_input_inv_scale();
+    float                   pdPreprocessorInput[kModelInputSize] = {0};
+    float                   pdOutputs[kOutputSize]               = {0};
+    bool                    fRestart                             = fRestartPending;
+    int                     ret                                  = 0;
+    rpeak_event_t           tRpeak                               = {0};
+
+    // 1) Check arguments
+    if ((pInterleaved == NULL) || (pOut == NULL) || (nSamples != ECG_ALGO_PACKET_SIZE))
+    {
+        return true;
+    }
+
+    // 2) Check if intialized
+    if (!fInitDone)
+    {
+        return true;
+    }
+
+    // 3) If restarting, clear pdStates and the rpeak detector
+    if (fRestart)
+    {
+        memset(pdStates, 0, sizeof(pdStates));
+        ABRPostProcess_ResetRPeakDetector();
+    }
+    pOut->fRpeakDetected = false;
+
+    for (size_t i = 0; i < nSamples; i++)
     {
-        custom_waist_get_states(pdStates);
-        custom_waist_get_outputs(pdOutputs);
+        const T *pFrame = &pInterleaved[i * kModelInputSize];
+        ECG_PROFILE_START(dwSampleStart);
+        ECG_PROFILE_START(dwMark);
+
+        // 4) Convert to mV without baseline and pre-process inputs
+        for (uint8_t ecg_ch = 0; ecg_ch < kModelInputSize; ecg_ch++)
+        {
+            pdPreprocessorInput[ecg_ch] = pPre->get_output(input_to_mv(pFrame[ecg_ch]), ecg_ch, fRestart, nGarmentID);
+        }
+        fRestart = false;
+        ECG_PROFILE_STAGE(ECG_STAGE_PREPROCESS, dwMark);
+
+        // 5) Scale mV to model input units, run the model and loop the states back
+        for (uint8_t ecg_ch = 0; ecg_ch < kModelInputSize; ecg_ch++)
+        {
+            pdPreprocessorInput[ecg_ch] *= dInputInvScale;
+        }
+        pOps->set_scaled_inputs(pdPreprocessorInput);
+        pOps->set_states(pdStates);
+        ECG_PROFILE_STAGE(ECG_STAGE_QUANTIZE, dwMark);
+        ret = pOps->inference();
+        if (ret == 1)
+        {
+            return true;
+        }
+        ECG_PROFILE_STAGE(ECG_STAGE_INFERENCE, dwMark);
+        pOps->get_states(pdStates);
+        pOps->get_outputs(pdOutputs);
+        ECG_PROFILE_STAGE(ECG_STAGE_DEQUANTIZE, dwMark);
+
+        // 6) Post-process the prediction, sample index resets the packet
+        pOut->pdPredictions[i] = pdOutputs[0];
+        ABRPostProcess_RPeak(pdOutputs[0], (uint8_t)i);
+        if (ABRPostProcess_DetectRPeak(pdOutputs[0], &tRpeak))
+        {
+            pOut->fRpeakDetected   = true;
+            pOut->dwRpeakTimestamp = tRpeak.timestamp;
+            pOut->dwRRInterval     = tRpeak.rr_interval;
+        }
+        ECG_PROFILE_STAGE(ECG_STAGE_POSTPROCESS, dwMark);
+        ECG_PROFILE_STAGE(ECG_STAGE_SAMPLE, dwSampleStart);
     }
-    else
+    fRestartPending = false;
+
+    // 7) Collect packet results; the rpeak keeps its last value if the
+    //    post-processor has no valid one (as with ABRPostProcess_GetRPeak)
+    ABRPostProcess_GetRPeak(&bRpeakValue, &bRpeakIndex);
+    pOut->bRpeakValue = bRpeakValue;
+    pOut->bRpeakIndex = bRpeakIndex;
+    for (uint8_t ecg_ch = 0; ecg_ch < kModelInputSize; ecg_ch++)
     {
-        custom_chest_get_states(pdStates);
-        custom_chest_get_outputs(pdOutputs);
+        pPre->get_quality((ecg_sens_id)ecg_ch, &pOut->pbQuality[ecg_ch], &pOut->pbSlope[ecg_ch]);
+    }
+
+    return false;
+}
+
+/*
+ * @brief  This function runs the ECG algorithm on a whole BLE packet: it
+ *         preprocesses every sample, runs the model, post-processes the rpeak
+ *         and collects the quality of each channel.
+ * @param  pdInterleaved - nSamples frames of ECG_ALGO_INPUT_SIZE samples in mV
+ *         (with baseline), interleaved as ch1, ch2, ch3, ch1, ...
+ * @param  nSamples - number of frames, must be ECG_ALGO_PACKET_SIZE
+ * @param  pOut - packet result
+ * @detail Equivalent to ECGAlgo_Run + ECGAlgo_GetOutput + ABRPostProcess_RPeak
+ *         + ABRPostProcess_DetectRPeak per sample, followed by
+ *         ABRPostProcess_GetRPeak and ABRPreProcess_GetQuality per channel,
+ *         but the arguments are checked and the garment model is fetched once
+ *         per packet. The first packet after ECGAlgo_Init restarts the
+ *         filters, model states and rpeak detector.
+ * @retval true on error
+ */
+bool ECGAlgo_RunBlock(const float *pdInterleaved, size_t nSamples, ecg_packet_out_t *pOut)
+{
+    return run_block(pdInterleaved, nSamples, pOut);
+}
+
+/*
+ * @brief  This function runs the ECG algorithm on a whole BLE packet of raw
+ *         ADC samples, as ECGAlgo_RunBlock.
+ * @param  pnInterleaved - nSamples frames of ECG_ALGO_INPUT_SIZE ADC counts,
+ *         interleaved as ch1, ch2, ch3, ch1, ...
+ * @param  nSamples - number of frames, must be ECG_ALGO_PACKET_SIZE
+ * @param  pOut - packet result
+ * @detail The baseline is removed in counts and the mV scale applied in the
+ *         same pass that feeds the pre-processor, without a float conversion
+ *         pass over the packet.
+ * @retval true on error
+ */
+bool ECGAlgo_RunBlockRaw(const int32_t *pnInterleaved, size_t nSamples, ecg_packet_out_t *pOut)
+{
+    return run_block(pnInterleaved, nSamples, pOut);
+}
+
+/*
+ * @brief  This function sets the timer used by the latency profiling
+ * @param  fnTimer - free running timer, e.g. the DWT cycle counter on the Pod,
+ *         NULL stops the profiling
+ * @param  dwTicksPerSecond - timer rate, sets the per-sample budget
+ * @detail Only available when built with ECG_ALGO_PROFILE. ECGAlgo_RunBlock
+ *         and ECGAlgo_RunBlockRaw then record the latency of every stage
+ *         into a log2 histogram. ECGAlgo_Run records the preprocess,
+ *         quantize and inference stages and ECGAlgo_GetOutput the dequantize
+ *         stage; the post-processing is the caller's, so the postprocess and
+ *         sample stages stay empty on that path.
+ * @retval no return type
+ */
+void ECGAlgo_SetProfileTimer(ecg_algo_timer_t fnTimer, uint32_t dwTicksPerSecond)
+{
+#ifdef ECG_ALGO_PROFILE
+    fnProfileTimer          = fnTimer;
+    dwProfileTicksPerSecond = dwTicksPerSecond;
+    dwProfileBudget         = dwTicksPerSecond / ECG_ALGO_SAMPLE_RATE;
+    ECGAlgo_ResetProfile();
+#endif
+
+    return;
+}
+
+/*
+ * @brief  This function clears the latency histograms
+ * @retval no return type
+ */
+void ECGAlgo_ResetProfile(void)
+{
+#ifdef ECG_ALGO_PROFILE
+    memset(tProfile, 0, sizeof(tProfile));
+#endif
+
+    return;
+}
+
+/*
+ * @brief  This function prints the latency histograms of every stage, with
+ *         the number of samples over the 1 / ECG_ALGO_SAMPLE_RATE budget
+ * @retval no return type
+ */
+void ECGAlgo_DumpProfile(void)
+{
+#ifdef ECG_ALGO_PROFILE
+    // 1) Check if a timer was set
+    if ((fnProfileTimer == NULL) || (dwProfileTicksPerSecond == 0))
+    {
+        printf("ECG profile: no timer\r\n");
+        return;
+    }
+
+    printf("ECG profile: %lu ticks/s, budget %lu ticks/sample\r\n", (unsigned long)dwProfileTicksPerSecond, (unsigned long)dwProfileBudget);
+    for (uint8_t bStage = 0; bStage < MAX_ECG_STAGE; bStage++)
+    {
+        const ecg_stage_profile_t *pStage = &tProfile[bStage];
+
+        // 2) Summary of the stage
+        printf("%-12s count %lu, mean %lu, max %lu, over budget %lu\r\n",
+               ppStageNames[bStage],
+               (unsigned long)pStage->dwCount,
+               (unsigned long)(pStage->dwCount ? (pStage->qwTotal / pStage->dwCount) : 0),
+               (unsigned long)pStage->dwMax,
+               (unsigned long)pStage->dwOverBudget);
+
+        // 3) Non-empty bins, [low, high) ticks
+        for (uint8_t bBin = 0; bBin < ECG_ALGO_PROFILE_BINS; bBin++)
+        {
+            if (pStage->pdwBins[bBin] == 0)
+            {
+                continue;
+            }
+            printf("    [%llu, %llu): %lu\r\n",
+                   (unsigned long long)(bBin ? (1ull << (bBin - 1)) : 0),
+                   (unsigned long long)(1ull << bBin),
+                   (unsigned long)pStage->pdwBins[bBin]);
+        }
     }
+#endif
 
     return;
 }
@@ -17,10 +17,65 @@ extern "C"
 // ABR model definitions
 #define ABR_INPUT_BASELINE_VALUE 685.7142857f
 
+// Raw 24 bit ADC input: mV = (counts - ABR_INPUT_BASELINE_COUNTS) * ABR_INPUT_MV_PER_COUNT
+#define ABR_INPUT_BASELINE_COUNTS 8000000                 // ABR_INPUT_BASELINE_VALUE in counts
+#define ABR_INPUT_MV_PER_COUNT    (3.0f / 35000.0f)       // 11666.67 counts per mV
+
+// Number of samples per channel in a BLE packet
+#define ECG_ALGO_PACKET_SIZE 24
+
+// ECG sample rate, the per-sample time budget
+#define ECG_ALGO_SAMPLE_RATE 320
+
+// Per-stage latency profiling, enabled by building with -DECG_ALGO_PROFILE.
+// ECGAlgo_RunBlock/RunBlockRaw record every stage; ECGAlgo_Run and
+// ECGAlgo_GetOutput record preprocess to dequantize only.
+#define ECG_ALGO_PROFILE_BINS 33    // log2 histogram: 0 ticks, then [2^(k-1), 2^k)
+
+typedef enum
+{
+    ECG_STAGE_PREPROCESS,     // baseline subtraction + pre-processor, 3 channels
+    ECG_STAGE_QUANTIZE,       // model input scaling and quantization, state quantization
+    ECG_STAGE_INFERENCE,
+    ECG_STAGE_DEQUANTIZE,     // model output and state dequantization
+    ECG_STAGE_POSTPROCESS,    // rpeak post-processing and detection
+    ECG_STAGE_SAMPLE,         // whole sample
+    MAX_ECG_STAGE,
+} ecg_stage_id_e;
+
+typedef uint32_t (*ecg_algo_timer_t)(void);
+
+// Selectable ECG pre-processors
+typedef enum
+{
+    ECG_PREPROC_ABR,     // notch + direct form bandpass (abr_preprocess.c)
+    ECG_PREPROC_SOW2,    // SOW2 state-space chain (sow2_preprocess.c)
+    MAX_ECG_PREPROC,
+} ecg_preproc_id_e;
+
+// Result of one BLE packet
+typedef struct
+{
+    uint8_t  bRpeakIndex;                             // 1 to 24, 0 if no rpeak
+    uint8_t  bRpeakValue;                             // 5 bit normalized rpeak
+    uint8_t  pbQuality[ECG_ALGO_INPUT_SIZE];          // quality class per channel
+    uint8_t  pbSlope[ECG_ALGO_INPUT_SIZE];            // quality slope per channel
+    float    pdPredictions[ECG_ALGO_PACKET_SIZE];     // model output per sample
+    bool     fRpeakDetected;                          // streaming detector found an rpeak
+    uint32_t dwRpeakTimestamp;                        // its sample index since ECGAlgo_Init
+    uint32_t dwRRInterval;                            // samples since the previous rpeak, 0 for the first
+} ecg_packet_out_t;
+
 void ECGAlgo_SetGarmentID(garment_id_e nID);
+void ECGAlgo_SetPreprocessor(ecg_preproc_id_e nID);
 void ECGAlgo_Init(void);
 bool ECGAlgo_Run(float *pdData, uint8_t bChannelCount, bool fRestart);
 void ECGAlgo_GetOutput(float *pdOutputs, uint8_t bLength);
+bool ECGAlgo_RunBlock(const float *pdInterleaved, size_t nSamples, ecg_packet_out_t *pOut);
+bool ECGAlgo_RunBlockRaw(const int32_t *pnInterleaved, size_t nSamples, ecg_packet_out_t *pOut);
+void ECGAlgo_SetProfileTimer(ecg_algo_timer_t fnTimer, uint32_t dwTicksPerSecond);
+void ECGAlgo_ResetProfile(void);
+void ECGAlgo_DumpProfile(void);
 
 #ifdef __cplusplus
 }
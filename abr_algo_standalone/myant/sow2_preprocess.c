@@ -0,0 +1,154 @@
+#include "sow2_preprocess.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+// Clip and latch definitions (see abr_sow2/pod/main.cc)
+#define SOW2_CLIP_CHEST          2.0f     // Chest output clip
+#define SOW2_LATCH_LOW_CHEST     0.15f    // Chest quality below this is clean
+#define SOW2_LATCH_HIGH_CHEST    0.9f     // Chest quality from this is noisy
+
+#define SOW2_CLIP_UDW            1.0f     // UDW output clip
+#define SOW2_LATCH_LOW_UDW       0.1f     // UDW quality below this is clean
+#define SOW2_LATCH_HIGH_UDW      0.7f     // UDW quality from this is noisy
+
+#define SOW2_MASK_STEP           0.015625f    // Mask ramp per sample (1/64)
+#define SLOPE_MAX                5
+
+// Pre-processing state and quality of one channel
+typedef struct
+{
+    float   lowpass;            // lowpass_subtract state
+    float   bandpass[2];        // state-space bandpass states
+    float   power;              // quality power lowpass state
+    float   mask;               // quality mask, ramps between 0 and 1
+    uint8_t mask_target;        // latched quality mask target
+    float   prev_ecg;
+    float   max_diff;
+    uint8_t slope;
+    bool    noise_detect;
+} sow2_channel_t;
+
+// Global variables
+static sow2_channel_t channel_state[MAX_ECG] = {0};
+
+static float dClip           = SOW2_CLIP_CHEST;
+static float dLatchLimitLow  = SOW2_LATCH_LOW_CHEST;
+static float dLatchLimitHigh = SOW2_LATCH_HIGH_CHEST;
+
+/*
+ * @brief  This function takes ecg data in mV and pre-processes it for the ABR
+ *         SOW2 model: lowpass subtract, state-space bandpass, quality power
+ *         lowpass, latched quality mask with a 1/64 ramp and clip.
+ * @param  x - mV output of ECG channel_1, ECG channel_2 or ECG channel_3,
+ *         baseline removed
+ * @param  ecg_ch - Channel id is used to keep track of the input data and output data.
+ * @param  restart - clear the channel state first
+ * @param  gar_id - unused, limits are set by SOW2PreProcess_SetLimits
+ * @detail Same chain as the SOW2 pod demo, with the slope and noise detection
+ *         of abr_preprocess.c so the BLE quality outputs stay available.
+ * @retval it returns processed ecg which is feed to the ABR model.
+ */
+float SOW2PreProcess_GetOutput(float x, uint8_t ecg_ch, bool restart, garment_id_e gar_id)
+{
+    sow2_channel_t *ch = &channel_state[ecg_ch];
+    float x_bp         = 0;
+    float q            = 0;
+    float diff         = 0;
+    float temp_state   = 0;
+
+    // 1) Reset channel if requested, the mask starts open
+    if (restart)
+    {
+        memset(ch, 0, sizeof(*ch));
+        ch->mask        = 1.0f;
+        ch->mask_target = 1;
+    }
+
+    // 2) Lowpass subtract
+    ch->lowpass = 0.9131007162822623f * ch->lowpass + 0.0868992837177377f * x;
+    x -= ch->lowpass;
+
+    // 3) Bandpass filter (state-space)
+    x_bp            = 0.31096514029047384f * ch->bandpass[0] + -0.32037364568502746f * ch->bandpass[1] + 0.20031153315903816f * x;
+    temp_state      = ch->bandpass[0];
+    ch->bandpass[0] = 1.552407569281504f * ch->bandpass[0] + -0.5993769336819238f * ch->bandpass[1] + x;
+    ch->bandpass[1] = temp_state;
+
+    // 4) Quality power with lowpass filter
+    q          = fabsf(x - x_bp);
+    temp_state = q;
+    q          = 0.037776709119069996f * ch->power + 0.019259274202335752f * temp_state;
+    ch->power  = 0.9614814515953285f * ch->power + temp_state;
+
+    // 5) Quality mask with latching
+    ch->mask_target = (q < dLatchLimitLow) ? 1 : ((q >= dLatchLimitHigh) || (ch->mask_target == 0)) ? 0 : 1;
+    ch->mask += (ch->mask_target) ? SOW2_MASK_STEP : -SOW2_MASK_STEP;
+    ch->mask = (ch->mask > 1.0f) ? 1.0f : (ch->mask < 0.0f) ? 0.0f : ch->mask;
+    if (ch->mask == 0.0f)
+    {
+        ch->noise_detect = true;
+    }
+
+    // 6) Slope, maximum difference between 2 samples since the last packet
+    diff = fabsf(ch->prev_ecg - x_bp);
+    if (diff > ch->max_diff)
+    {
+        ch->max_diff = diff;
+    }
+    if (ch->max_diff > SLOPE_MAX)
+    {
+        ch->max_diff = SLOPE_MAX;
+    }
+    ch->prev_ecg = x_bp;
+    ch->slope    = (uint8_t)((ch->max_diff / 5) * 200);
+
+    // 7) Mask and clip
+    x = x_bp * ch->mask;
+    x = (x < -dClip) ? -dClip : (x > dClip) ? dClip : x;
+
+    return x;
+}
+
+/*
+ * @brief  This function is used to get processed quality slope and class
+ * @param  slope and quality pointer from sens_ecg.c
+ * @detail A channel is noisy if its quality mask fully closed since the last
+ *         call.
+ * @retval It updates the pointer passed from the sens_ecg.c
+ */
+void SOW2PreProcess_GetQuality(ecg_sens_id ecg_id, uint8_t *q_class, uint8_t *slope)
+{
+    sow2_channel_t *ch = &channel_state[ecg_id];
+
+    *q_class = ((ch->noise_detect == true) ? Q_NOISY : Q_CLEAN) - 1;
+    *slope   = ch->slope;
+
+    ch->slope        = 0;
+    ch->noise_detect = false;
+    ch->max_diff     = 0.0f;
+}
+
+/*
+ * @brief  This function updates the quality latch limits and output clip.
+ * @param  nID - the garment ID, represents which garment is used
+ * @retval no return type
+ */
+void SOW2PreProcess_SetLimits(garment_id_e nID)
+{
+    if (nID == GARMENT_UNDERWEAR)
+    {
+        dClip           = SOW2_CLIP_UDW;
+        dLatchLimitLow  = SOW2_LATCH_LOW_UDW;
+        dLatchLimitHigh = SOW2_LATCH_HIGH_UDW;
+    }
+    else
+    {
+        dClip           = SOW2_CLIP_CHEST;
+        dLatchLimitLow  = SOW2_LATCH_LOW_CHEST;
+        dLatchLimitHigh = SOW2_LATCH_HIGH_CHEST;
+    }
+
+    return;
+}
@@ -0,0 +1,12 @@
+#ifndef SOW2_PREPROCESS_H_
+#define SOW2_PREPROCESS_H_
+
+#include "abr_preprocess.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+float SOW2PreProcess_GetOutput(float x, uint8_t ecg_ch, bool restart, garment_id_e gar_id);
+void SOW2PreProcess_GetQuality(ecg_sens_id ecg_id, uint8_t *q_class, uint8_t *slope);
+void SOW2PreProcess_SetLimits(garment_id_e nID);
+
+#endif /* SOW2_PREPROCESS_H_ */
@@ -0,0 +1,255 @@
+#include "myant/abr_preprocess.h"
+#include "myant/sow2_preprocess.h"
+#include "myant/abr_postprocess.h"
+#include "myant/ecg_algo.h"
+#include "data_chest.h"
+#include "data_waist.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_REPEATS 1000     // Passes over the data set for the timing
+#define ATOL          0.001f   // Same tolerances as the pod demo
+#define RTOL          0.001f
+#define FRAME_FIELD   32       // Values of the 5 bit rpeak index and value
+#define FRAME_SLOPE   256      // Values of a slope byte
+
+typedef struct
+{
+    const char       *pName;
+    ecg_preproc_id_e  nID;
+    float (*get_output)(float x, uint8_t ecg_ch, bool restart, garment_id_e gar_id);
+    void (*set_limits)(garment_id_e nID);
+} bench_preproc_t;
+
+typedef struct
+{
+    const char   *pName;
+    garment_id_e  nID;
+    float (*pInput)[N_CHANNELS];
+    float (*pPreproc)[N_CHANNELS];
+    float (*pReference)[N_OUTPUTS];
+} bench_garment_t;
+
+static const bench_preproc_t tPreprocs[] =
+{
+    {"abr",  ECG_PREPROC_ABR,  ABRPreProcess_GetOutput,  ABRPreProcess_SetLatchLimits},
+    {"sow2", ECG_PREPROC_SOW2, SOW2PreProcess_GetOutput, SOW2PreProcess_SetLimits},
+};
+
+static const bench_garment_t tGarments[] =
+{
+    {"chest", GARMENT_CHEST_BAND, chest_input_data, chest_preproc_data, chest_reference_output},
+    {"waist", GARMENT_UNDERWEAR,  waist_input_data, waist_preproc_data, waist_reference_output},
+};
+
+static volatile float dSink = 0;
+
+static bool is_close(float ref, float value)
+{
+    return fabsf(ref - value) <= ATOL + RTOL * fabsf(ref);
+}
+
+/*
+ * @brief  This function compares a pre-processor against the reference
+ *         pre-processed data and times it.
+ * @param  pPre - pre-processor under test
+ * @param  pGar - garment data set
+ * @retval no return type
+ */
+static void bench_preprocessor(const bench_preproc_t *pPre, const bench_garment_t *pGar)
+{
+    int     nClose   = 0;
+    float   dMaxErr  = 0;
+    float   dOut     = 0;
+    clock_t tStart   = 0;
+    double  dSeconds = 0;
+
+    // 1) Accuracy against the reference, in mV
+    pPre->set_limits(pGar->nID);
+    for (int i = 0; i < N_STEPS; i++)
+    {
+        for (uint8_t ch = 0; ch < N_CHANNELS; ch++)
+        {
+            dOut = pPre->get_output(pGar->pInput[i][ch], ch, i == 0, pGar->nID);
+            nClose += is_close(pGar->pPreproc[i][ch], dOut);
+            if (fabsf(pGar->pPreproc[i][ch] - dOut) > dMaxErr)
+            {
+                dMaxErr = fabsf(pGar->pPreproc[i][ch] - dOut);
+            }
+        }
+    }
+
+    // 2) Time per sample
+    tStart = clock();
+    for (int r = 0; r < BENCH_REPEATS; r++)
+    {
+        for (int i = 0; i < N_STEPS; i++)
+        {
+            for (uint8_t ch = 0; ch < N_CHANNELS; ch++)
+            {
+                dSink = pPre->get_output(pGar->pInput[i][ch], ch, i == 0, pGar->nID);
+            }
+        }
+    }
+    dSeconds = (double)(clock() - tStart) / CLOCKS_PER_SEC;
+
+    printf("%-5s %-5s pre: %4d/%d close, max error %8.4f, %6.1f ns/sample\r\n",
+           pGar->pName, pPre->pName, nClose, N_STEPS * N_CHANNELS, (double)dMaxErr,
+           dSeconds * 1e9 / ((double)BENCH_REPEATS * N_STEPS * N_CHANNELS));
+
+    return;
+}
+
+/*
+ * @brief  This function runs the initialized ECG algorithm over a garment
+ *         data set.
+ * @param  pGar - garment data set
+ * @retval number of model outputs close to the reference output
+ */
+static int run_algorithm(const bench_garment_t *pGar)
+{
+    float pdData[ECG_ALGO_INPUT_SIZE]    = {0};
+    float pdOutput[ECG_ALGO_OUTPUT_SIZE] = {0};
+    int   nClose                         = 0;
+
+    for (int i = 0; i < N_STEPS; i++)
+    {
+        for (uint8_t ch = 0; ch < N_CHANNELS; ch++)
+        {
+            pdData[ch] = pGar->pInput[i][ch] + ABR_INPUT_BASELINE_VALUE;
+        }
+        ECGAlgo_Run(pdData, ECG_ALGO_INPUT_SIZE, i == 0);
+        ECGAlgo_GetOutput(pdOutput, ECG_ALGO_OUTPUT_SIZE);
+        nClose += is_close(pGar->pReference[i][0], pdOutput[0]);
+    }
+
+    return nClose;
+}
+
+/*
+ * @brief  This function runs the ECG algorithm in its default configuration,
+ *         ECGAlgo_Init only, on the default garment (waist). Must run before
+ *         any ECGAlgo_Set* call. Only the latch limits are set, as the
+ *         pre-processor has no default for them.
+ * @retval no return type
+ */
+static void bench_default_init(void)
+{
+    const bench_garment_t *pGar = &tGarments[1];
+
+    ABRPreProcess_SetLatchLimits(pGar->nID);
+    ECGAlgo_Init();
+
+    printf("%-5s %-5s rpeak: %4d/%d close to the reference output (default init)\r\n",
+           pGar->pName, tPreprocs[0].pName, run_algorithm(pGar), N_STEPS);
+
+    return;
+}
+
+/*
+ * @brief  This function runs the ECG algorithm with a pre-processor and
+ *         compares the model output against the reference output.
+ * @param  pPre - pre-processor under test
+ * @param  pGar - garment data set
+ * @retval no return type
+ */
+static void bench_algorithm(const bench_preproc_t *pPre, const bench_garment_t *pGar)
+{
+    ECGAlgo_SetGarmentID(pGar->nID);
+    ECGAlgo_SetPreprocessor(pPre->nID);
+    ECGAlgo_Init();
+
+    printf("%-5s %-5s rpeak: %4d/%d close to the reference output\r\n",
+           pGar->pName, pPre->pName, run_algorithm(pGar), N_STEPS);
+
+    return;
+}
+
+/*
+ * @brief  This function round trips one result through the BLE frame.
+ * @param  pResult - packet results, every field within its bit width
+ * @retval true if the decoded results differ
+ */
+static bool frame_round_trip(const abr_ble_result_t *pResult)
+{
+    uint8_t          pbFrame[ABR_BLE_FRAME_SIZE] = {0};
+    abr_ble_result_t tDecoded                    = {0};
+
+    ABRPostProcess_EncodeFrame(pResult, pbFrame);
+    ABRPostProcess_DecodeFrame(pbFrame, &tDecoded);
+
+    return memcmp(pResult, &tDecoded, sizeof(tDecoded)) != 0;
+}
+
+/*
+ * @brief  This function round trips the BLE frame over every combination of
+ *         rpeak index, rpeak value and quality bits, with the slopes set
+ *         from them, then over every slope code of each channel.
+ * @retval number of results that do not round trip
+ */
+static size_t bench_frame(void)
+{
+    abr_ble_result_t tResult = {0};
+    size_t           nErrors = 0;
+    size_t           nFrames = 0;
+
+    // 1) Rpeak index and value, up to their 5 bit limits, and quality bits
+    for (uint8_t bIndex = 0; bIndex < FRAME_FIELD; bIndex++)
+    {
+        for (uint8_t bValue = 0; bValue < FRAME_FIELD; bValue++)
+        {
+            for (uint8_t bQuality = 0; bQuality < (1 << MAX_ECG); bQuality++)
+            {
+                tResult.rpeak_index = bIndex;
+                tResult.rpeak_value = bValue;
+                for (uint8_t ch = 0; ch < MAX_ECG; ch++)
+                {
+                    tResult.quality[ch] = (bQuality >> ch) & 0x01;
+                    tResult.slope[ch]   = (uint8_t)(bIndex * FRAME_FIELD + bValue + ch);
+                }
+                nErrors += frame_round_trip(&tResult);
+                nFrames++;
+            }
+        }
+    }
+
+    // 2) Every slope code of each channel, the others at the opposite code
+    for (uint8_t ch = 0; ch < MAX_ECG; ch++)
+    {
+        for (uint16_t wSlope = 0; wSlope < FRAME_SLOPE; wSlope++)
+        {
+            for (uint8_t other = 0; other < MAX_ECG; other++)
+            {
+                tResult.slope[other] = (uint8_t)~wSlope;
+            }
+            tResult.slope[ch] = (uint8_t)wSlope;
+            nErrors += frame_round_trip(&tResult);
+            nFrames++;
+        }
+    }
+
+    printf("ble frame: %zu/%zu round trip errors\r\n", nErrors, nFrames);
+
+    return nErrors;
+}
+
+int main(int argc, const char *argv[])
+{
+    size_t nErrors = bench_frame();
+
+    bench_default_init();
+
+    for (size_t g = 0; g < sizeof(tGarments) / sizeof(tGarments[0]); g++)
+    {
+        for (size_t p = 0; p < sizeof(tPreprocs) / sizeof(tPreprocs[0]); p++)
+        {
+            bench_preprocessor(&tPreprocs[p], &tGarments[g]);
+            bench_algorithm(&tPreprocs[p], &tGarments[g]);
+        }
+    }
+
+    return (nErrors == 0) ? 0 : 1;
+}
@@ -0,0 +1,422 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "activity.h"
+#include "activity_reference.h"
+#include "activity_tree.h"
+
+#define BENCH_SAMPLES       1200000     // Synthetic recording length, 100000 windows
+#define BENCH_G_COUNTS      4096        // 1 g in IMU counts (see PREPROCESS_FACTOR)
+#define BENCH_FS            12.5f       // Synthetic IMU sample rate in Hz
+#define BENCH_PI            3.14159265f
+#define BENCH_NO_LABEL      0xFF        // No reference window ends at this sample
+#define BENCH_MAX_MISMATCH  10000       // Windows per allowed mismatch, for features within
+                                        // the acos error of a threshold
+#define BENCH_ZERO_SAMPLE   (BENCH_SAMPLES / 2 + 18)   // Zero magnitude sample, mid window and
+                                                // just after a sliding window resync
+#define BENCH_STEADY        480         // Still upright samples around the zero sample
+#define BENCH_TREE_NODES    256         // Largest tree blob act_set_decision_tree takes
+
+typedef struct
+{
+    const char *pName;
+    void (*init)(void);
+    void (*add_raw_acc)(imu_axis_t axis);
+    activity_t (*process)(void);
+    bool (*is_window_ready)(void);
+    uint16_t nHop;              // Sliding window hop, 0 for disjoint windows
+} bench_act_t;
+
+typedef struct
+{
+    int16_t *px;
+    int16_t *py;
+    int16_t *pz;
+    size_t   nSamples;
+} bench_recording_t;
+
+static bool act_ref_is_window_ready(void)
+{
+    return act_ref_get_samples_count() > (N_ACC_SAMPLES - 1);
+}
+
+static const bench_act_t tFloat     = {"float",  act_init,     act_add_raw_acc,     process_act_algo,     act_is_window_ready,     0};
+static const bench_act_t tSliding   = {"slide1", act_init,     act_add_raw_acc,     process_act_algo,     act_is_window_ready,     1};
+static const bench_act_t tReference = {"double", act_ref_init, act_ref_add_raw_acc, process_act_ref_algo, act_ref_is_window_ready, 0};
+
+static volatile activity_t nSink = ACT_UNKNOWN;
+static act_batch_scratch_t tScratch;
+static uint32_t dwSeed = 1;
+
+static float bench_random(void)
+{
+    dwSeed = dwSeed * 1664525u + 1013904223u;
+
+    return (float)(dwSeed >> 8) * (1.0f / 16777216.0f);
+}
+
+static int16_t bench_clip(float x)
+{
+    return (int16_t)((x > 32767.0f) ? 32767.0f : (x < -32768.0f) ? -32768.0f : x);
+}
+
+/*
+ * @brief  This function allocates a recording of nSamples IMU samples.
+ * @retval true on allocation failure
+ */
+static bool bench_alloc(bench_recording_t *pRec, size_t nSamples)
+{
+    pRec->px       = (int16_t *)realloc(pRec->px, nSamples * sizeof(int16_t));
+    pRec->py       = (int16_t *)realloc(pRec->py, nSamples * sizeof(int16_t));
+    pRec->pz       = (int16_t *)realloc(pRec->pz, nSamples * sizeof(int16_t));
+    pRec->nSamples = nSamples;
+
+    return (pRec->px == NULL) || (pRec->py == NULL) || (pRec->pz == NULL);
+}
+
+/*
+ * @brief  This function loads an IMU recording from a text file with one
+ *         "x,y,z" sample per line, in raw IMU counts.
+ * @retval true if the file can not be read
+ */
+static bool bench_load(bench_recording_t *pRec, const char *pPath)
+{
+    FILE  *pFile = fopen(pPath, "r");
+    size_t n     = 0;
+    int    x     = 0;
+    int    y     = 0;
+    int    z     = 0;
+
+    if (pFile == NULL)
+    {
+        return true;
+    }
+
+    while (fscanf(pFile, " %d , %d , %d", &x, &y, &z) == 3)
+    {
+        if ((n >= pRec->nSamples) && bench_alloc(pRec, (n + 1) * 2))
+        {
+            fclose(pFile);
+            return true;
+        }
+        pRec->px[n] = (int16_t)x;
+        pRec->py[n] = (int16_t)y;
+        pRec->pz[n] = (int16_t)z;
+        n++;
+    }
+    fclose(pFile);
+    pRec->nSamples = n;
+
+    return n == 0;
+}
+
+/*
+ * @brief  This function synthesizes a long recording of random postures,
+ *         each held for 5 seconds to 1 minute, with gait-like oscillation on
+ *         the vertical axis and sensor noise.
+ * @details Tilt and oscillation amplitude are drawn across the whole range of
+ *          the model thresholds so many windows land close to a decision
+ *          boundary, which is where float and double can disagree. One
+ *          sample in a still upright stretch is zero on all axes.
+ * @retval true on allocation failure
+ */
+static bool bench_synthesize(bench_recording_t *pRec)
+{
+    size_t n      = 0;
+    size_t nEnd   = 0;
+    float  tilt   = 0;
+    float  az     = 0;
+    float  amp    = 0;
+    float  freq   = 0;
+    float  phase  = 0;
+
+    if (bench_alloc(pRec, BENCH_SAMPLES))
+    {
+        return true;
+    }
+
+    while (n < BENCH_SAMPLES)
+    {
+        // 1) New segment: posture, then walking/running intensity
+        nEnd  = n + (size_t)(BENCH_FS * (5.0f + 55.0f * bench_random()));
+        tilt  = BENCH_PI * bench_random();
+        az    = 2.0f * BENCH_PI * bench_random();
+        amp   = (bench_random() < 0.5f) ? 0.1f * bench_random() : 1.5f * bench_random();
+        freq  = 0.5f + 2.5f * bench_random();
+
+        // 2) Samples of the segment, in counts
+        for (; (n < nEnd) && (n < BENCH_SAMPLES); n++)
+        {
+            phase      += 2.0f * BENCH_PI * freq / BENCH_FS;
+            pRec->px[n] = bench_clip(BENCH_G_COUNTS * (-cosf(tilt) + amp * sinf(phase) + 0.02f * (bench_random() - 0.5f)));
+            pRec->py[n] = bench_clip(BENCH_G_COUNTS * (sinf(tilt) * cosf(az) + 0.3f * amp * sinf(0.5f * phase) + 0.02f * (bench_random() - 0.5f)));
+            pRec->pz[n] = bench_clip(BENCH_G_COUNTS * (sinf(tilt) * sinf(az) + 0.02f * (bench_random() - 0.5f)));
+        }
+    }
+
+    // 3) A glitch with zero magnitude, its angle is undefined, while upright
+    //    and still, where a wrong theta_mean gives LYING
+    for (n = BENCH_ZERO_SAMPLE - BENCH_STEADY / 2; n < BENCH_ZERO_SAMPLE + BENCH_STEADY / 2; n++)
+    {
+        pRec->px[n] = (int16_t)(BENCH_G_COUNTS * 0.98f);
+        pRec->py[n] = (int16_t)(BENCH_G_COUNTS * 0.2f);
+        pRec->pz[n] = 0;
+    }
+    pRec->px[BENCH_ZERO_SAMPLE] = 0;
+    pRec->py[BENCH_ZERO_SAMPLE] = 0;
+    pRec->pz[BENCH_ZERO_SAMPLE] = 0;
+
+    return false;
+}
+
+/*
+ * @brief  This function feeds one IMU sample and classifies at the end of a
+ *         window, the same way as main.c.
+ * @retval true if a window was classified into *pOut
+ */
+static bool bench_step(const bench_act_t *pAct, const bench_recording_t *pRec, size_t i, activity_t *pOut)
+{
+    imu_axis_t acc = {pRec->px[i], pRec->py[i], pRec->pz[i], 0};
+
+    pAct->add_raw_acc(acc);
+    if (pAct->is_window_ready())
+    {
+        *pOut = pAct->process();
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * @brief  This function times one implementation over the whole recording.
+ * @retval ns per IMU sample, window classification included
+ */
+static double bench_time(const bench_act_t *pAct, const bench_recording_t *pRec)
+{
+    activity_t nAct   = ACT_UNKNOWN;
+    clock_t    tStart = 0;
+
+    act_set_sliding_window(pAct->nHop);
+    pAct->init();
+    tStart = clock();
+    for (size_t i = 0; i < pRec->nSamples; i++)
+    {
+        if (bench_step(pAct, pRec, i, &nAct))
+        {
+            nSink = nAct;
+        }
+    }
+
+    return (double)(clock() - tStart) / CLOCKS_PER_SEC * 1e9 / (double)pRec->nSamples;
+}
+
+/*
+ * @brief  This function runs the double reference over the recording from
+ *         sample nOffset and stores the label of each window at the index of
+ *         its last sample.
+ * @retval number of windows
+ */
+static size_t bench_reference(const bench_recording_t *pRec, size_t nOffset, uint8_t *pLabels)
+{
+    activity_t nAct     = ACT_UNKNOWN;
+    size_t     nWindows = 0;
+
+    tReference.init();
+    for (size_t i = nOffset; i < pRec->nSamples; i++)
+    {
+        if (bench_step(&tReference, pRec, i, &nAct))
+        {
+            pLabels[i] = (uint8_t)nAct;
+            nWindows++;
+        }
+    }
+
+    return nWindows;
+}
+
+/*
+ * @brief  This function runs the float algorithm over the recording and
+ *         compares each window label with the reference labels.
+ * @retval number of mismatches, or the number of windows if a window has no
+ *         reference label
+ */
+static size_t bench_compare(const bench_act_t *pAct, const bench_recording_t *pRec, const uint8_t *pLabels, size_t *pnWindows)
+{
+    activity_t nAct      = ACT_UNKNOWN;
+    size_t     nMismatch = 0;
+
+    *pnWindows = 0;
+    act_set_sliding_window(pAct->nHop);
+    pAct->init();
+    for (size_t i = 0; i < pRec->nSamples; i++)
+    {
+        if (!bench_step(pAct, pRec, i, &nAct))
+        {
+            continue;
+        }
+        (*pnWindows)++;
+        if (pLabels[i] == BENCH_NO_LABEL)
+        {
+            printf("  %s: no reference window ending at sample %zu\r\n", pAct->pName, i);
+            return *pnWindows;
+        }
+        if ((uint8_t)nAct != pLabels[i])
+        {
+            nMismatch++;
+            if (nMismatch <= 10)
+            {
+                printf("  %s: window ending at sample %zu, float %d, double %d\r\n", pAct->pName, i, nAct, pLabels[i]);
+            }
+        }
+    }
+
+    return nMismatch;
+}
+
+/*
+ * @brief  This function classifies the recording with act_process_batch and
+ *         compares each window label with the reference labels.
+ * @param  pSeconds - time taken by act_process_batch
+ * @retval number of mismatches
+ */
+static size_t bench_batch(const bench_recording_t *pRec, const uint8_t *pLabels, activity_t *pOut, size_t *pnWindows, double *pSeconds)
+{
+    size_t  nMismatch = 0;
+    clock_t tStart    = clock();
+
+    *pnWindows = act_process_batch(pRec->px, pRec->py, pRec->pz, (uint32_t)pRec->nSamples, pOut, &tScratch);
+    *pSeconds  = (double)(clock() - tStart) / CLOCKS_PER_SEC;
+
+    for (size_t w = 0; w < *pnWindows; w++)
+    {
+        if ((uint8_t)pOut[w] != pLabels[(w + 1) * N_ACC_SAMPLES - 1])
+        {
+            nMismatch++;
+            if (nMismatch <= 10)
+            {
+                printf("  batch: window %zu, float %d, double %d\r\n", w, pOut[w], pLabels[(w + 1) * N_ACC_SAMPLES - 1]);
+            }
+        }
+    }
+
+    return nMismatch;
+}
+
+/*
+ * @brief  This function checks that act_set_decision_tree accepts the
+ *         generated tree and a 256 node chain whose nodes both point to the
+ *         next one, and rejects a too small depth, a backward child, and a
+ *         leaf with an unknown feature or a label outside activity_t.
+ * @retval number of wrong verdicts
+ */
+static size_t bench_tree_blobs(void)
+{
+    static act_tree_node_t tChain[BENCH_TREE_NODES];
+    size_t  nErrors = 0;
+    clock_t tStart  = 0;
+
+    for (uint16_t i = 0; i < BENCH_TREE_NODES; i++)
+    {
+        uint8_t next = (uint8_t)((i + 1 < BENCH_TREE_NODES) ? i + 1 : i);
+        tChain[i] = (act_tree_node_t){ACT_FEATURE_ACCX_MEAN, 0.0f, {next, next}, ACT_SEAT_STAND};
+    }
+
+    tStart   = clock();
+    nErrors += act_set_decision_tree(tChain, BENCH_TREE_NODES, BENCH_TREE_NODES - 1);
+    nErrors += !act_set_decision_tree(tChain, BENCH_TREE_NODES, BENCH_TREE_NODES - 2);
+    tChain[100].child[1] = 50;
+    nErrors += !act_set_decision_tree(tChain, BENCH_TREE_NODES, BENCH_TREE_NODES - 1);
+    tChain[100].child[1] = 101;
+    tChain[BENCH_TREE_NODES - 1].feature = 0xFF;
+    nErrors += !act_set_decision_tree(tChain, BENCH_TREE_NODES, BENCH_TREE_NODES - 1);
+    tChain[BENCH_TREE_NODES - 1].feature = ACT_FEATURE_ACCX_MEAN;
+    tChain[BENCH_TREE_NODES - 1].label   = ACT_RESERVED4 + 1;
+    nErrors += !act_set_decision_tree(tChain, BENCH_TREE_NODES, BENCH_TREE_NODES - 1);
+    tChain[BENCH_TREE_NODES - 1].label   = ACT_RESERVED4;
+    nErrors += act_set_decision_tree(tChain, BENCH_TREE_NODES, BENCH_TREE_NODES - 1);
+    nErrors += !act_set_decision_tree(act_tree, ACT_TREE_NODES, ACT_TREE_DEPTH - 1);
+    nErrors += act_set_decision_tree(act_tree, ACT_TREE_NODES, ACT_TREE_DEPTH);
+    printf("tree   %zu wrong verdicts on the tree blobs, %.3f ms\r\n", nErrors,
+           (double)(clock() - tStart) / CLOCKS_PER_SEC * 1e3);
+
+    return nErrors;
+}
+
+int main(int argc, const char *argv[])
+{
+    bench_recording_t tRec      = {0};
+    uint8_t          *pLabels   = NULL;
+    activity_t       *pBatch    = NULL;
+    double            dSeconds  = 0;
+    size_t            nWindows  = 0;
+    size_t            nRefs     = 0;
+    size_t            nMismatch = 0;
+    size_t            nErrors   = 0;
+
+    // 1) IMU recording from file, or a synthetic one
+    if ((argc > 1) ? bench_load(&tRec, argv[1]) : bench_synthesize(&tRec))
+    {
+        printf("Can not load the IMU recording\r\n");
+        return -1;
+    }
+    printf("%s: %zu IMU samples\r\n", (argc > 1) ? argv[1] : "synthetic", tRec.nSamples);
+
+    pLabels = (uint8_t *)malloc(tRec.nSamples);
+    pBatch  = (activity_t *)malloc((tRec.nSamples / N_ACC_SAMPLES + 1) * sizeof(activity_t));
+    if ((pLabels == NULL) || (pBatch == NULL))
+    {
+        return -1;
+    }
+
+    // 2) Disjoint windows against the double reference, for every garment
+    for (int g = 0; g < MAX_GARMENTS; g++)
+    {
+        act_set_garment((garment_id_e)g);
+        act_ref_set_garment((garment_id_e)g);
+        memset(pLabels, BENCH_NO_LABEL, tRec.nSamples);
+        nRefs     = bench_reference(&tRec, 0, pLabels);
+        nMismatch = bench_compare(&tFloat, &tRec, pLabels, &nWindows);
+        nErrors  += (nMismatch * BENCH_MAX_MISMATCH > nWindows) || (nWindows != nRefs);
+        printf("%-6s garment %d: %zu/%zu windows, %zu mismatches\r\n", tFloat.pName, g, nWindows, nRefs, nMismatch);
+
+        nMismatch = bench_batch(&tRec, pLabels, pBatch, &nWindows, &dSeconds);
+        nErrors  += (nMismatch * BENCH_MAX_MISMATCH > nWindows) || (nWindows != nRefs);
+        printf("%-6s garment %d: %zu/%zu windows, %zu mismatches\r\n", "batch", g, nWindows, nRefs, nMismatch);
+    }
+    act_set_garment(GARMENT_UNDERWEAR);
+    act_ref_set_garment(GARMENT_UNDERWEAR);
+
+    // 3) Sliding window with a hop of 1 against the reference started at every
+    //    offset of the window, which together cover every window position
+    memset(pLabels, BENCH_NO_LABEL, tRec.nSamples);
+    nRefs = 0;
+    for (size_t k = 0; k < N_ACC_SAMPLES; k++)
+    {
+        nRefs += bench_reference(&tRec, k, pLabels);
+    }
+    nMismatch = bench_compare(&tSliding, &tRec, pLabels, &nWindows);
+    nErrors  += (nMismatch * BENCH_MAX_MISMATCH > nWindows) || (nWindows != nRefs);
+    printf("%-6s %zu/%zu windows, %zu mismatches\r\n", tSliding.pName, nWindows, nRefs, nMismatch);
+
+    // 4) Decision tree blobs
+    nErrors += bench_tree_blobs();
+
+    // 5) Cost per sample
+    printf("%-6s %6.1f ns/sample\r\n", tReference.pName, bench_time(&tReference, &tRec));
+    printf("%-6s %6.1f ns/sample\r\n", tFloat.pName, bench_time(&tFloat, &tRec));
+    printf("%-6s %6.1f ns/sample\r\n", tSliding.pName, bench_time(&tSliding, &tRec));
+    bench_batch(&tRec, pLabels, pBatch, &nWindows, &dSeconds);
+    printf("%-6s %6.1f ns/sample\r\n", "batch", dSeconds * 1e9 / (double)tRec.nSamples);
+
+    act_set_sliding_window(0);
+    free(pLabels);
+    free(pBatch);
+    free(tRec.px);
+    free(tRec.py);
+    free(tRec.pz);
+
+    return (nErrors == 0) ? 0 : 1;
+}
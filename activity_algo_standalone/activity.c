@@ -1,21 +1,16 @@
 #include <math.h>
 #include <string.h>
 #include "activity.h"
+#include "activity_tree.h"     // the tree is provided by data science team
 
-#define GARMENT_ID_DEFAULT  GARMENT_UNDERWEAR   // Assume underwear, all other garments function the same way
+#define GARMENT_ID_DEFAULT  GARMENT_UNDERWEAR   // Until act_set_garment is called
 
 //number of samples to accumulate before calculating the posture
 // #define N_ACC_SAMPLES   12   XXX - Moved to header
 #define ACT_TX_SAMP     1
-#define PREPROCESS_FACTOR               0.00239501953125 // 9.81/4096
-
-// the values are provided by data science team
-#define ACCX_MEAN_UPPER_THRESHOLD       -4.520100
-#define ACCX_MEAN_LOWER_THRESHOLD       -8.251441
-#define R_P2P_UPPER_THRESHOLD           1.002060
-#define R_P2P_LOWER_THRESHOLD           0.713003
-#define THETA_MEAN_THRESHOLD            1.101531
-#define ACCX_STD_THRESHOLD              5.999058
+#define PREPROCESS_FACTOR               0.00239501953125f // 9.81/4096
+#define ACT_PI                          3.14159265f
+#define SLIDE_RESYNC_SAMPLES            240     // Sliding sums are recomputed from the window this often
 
 //vector of 3-axes point
 typedef struct
@@ -28,38 +23,88 @@ typedef struct
 typedef struct
 {
     axis_t raw;
-    double accx_mean;
-    double accx_std;
-    double theta_mean;
-    double r_p2p;
-    double theta;
-    double r;
+    float accx_mean;
+    float accx_std;
+    float theta_mean;
+    float r_p2p;
+    float theta;
+    float r;
+    float accx_m2;      // Welford sum of squared x deviations of the window
+    float theta_sum;
+    float r_max;
+    float r_min;
 }algo_pp_t;
 
 typedef struct
 {
-    int32_t x;
-    int32_t y;
-    int32_t z;
     uint16_t samples;
     bool processing;
 }acc_axis_t;
 
+// Signed axis permutation of a garment, fused with the PREPROCESS_FACTOR
+typedef struct
+{
+    uint8_t src[3];             // IMU axis (0 x, 1 y, 2 z) of each algorithm axis
+    float scale[3];             // Sign times PREPROCESS_FACTOR of each algorithm axis
+}axis_remap_t;
+
+// Ring of window slots whose r values are monotonic, the front is the extreme
+typedef struct
+{
+    uint8_t slot[N_ACC_SAMPLES];
+    uint8_t head;
+    uint8_t count;
+}slot_deque_t;
+
+// Last N_ACC_SAMPLES samples and their features for the sliding window mode
+typedef struct
+{
+    float x[N_ACC_SAMPLES];
+    float theta[N_ACC_SAMPLES];
+    float r[N_ACC_SAMPLES];
+    slot_deque_t r_max;         // Decreasing r values
+    slot_deque_t r_min;         // Increasing r values
+    float accx_mean;
+    float accx_m2;
+    float theta_sum;
+    uint8_t pos;                // Next slot to write, the oldest sample once full
+    uint8_t count;              // Samples in the window
+    uint16_t resync;            // Samples since the sums were recomputed
+}slide_window_t;
+
+// The algorithm z axis is the opposite of the IMU z axis for all garments
+static const axis_remap_t garment_remap[MAX_GARMENTS] =
+{
+    [GARMENT_UNDERWEAR]       = {{0, 1, 2}, { PREPROCESS_FACTOR, PREPROCESS_FACTOR, -PREPROCESS_FACTOR}},
+    [GARMENT_BRA_TANK]        = {{0, 1, 2}, {-PREPROCESS_FACTOR, PREPROCESS_FACTOR,  PREPROCESS_FACTOR}},
+    [GARMENT_CHEST_BAND]      = {{1, 0, 2}, {-PREPROCESS_FACTOR, PREPROCESS_FACTOR, -PREPROCESS_FACTOR}},
+    [GARMENT_BRALETTE]        = {{0, 1, 2}, {-PREPROCESS_FACTOR, PREPROCESS_FACTOR,  PREPROCESS_FACTOR}},
+    [GARMENT_PEDIATRIC_BAND]  = {{0, 1, 2}, { PREPROCESS_FACTOR, PREPROCESS_FACTOR, -PREPROCESS_FACTOR}},
+};
 
 static acc_axis_t rawaxis = {0};
 static act_data_t activity = {0};   // Last valid detected activity
 static bool algo_enabled = true;    // Flag to enable/disable activity algo
+static uint16_t slide_hop = 0;      // Samples between sliding window outputs, 0 for disjoint windows
+static const axis_remap_t *remap = &garment_remap[GARMENT_ID_DEFAULT];
 
 // Algo variables
 static algo_pp_t algo_input = {0};
-static double sample_pp_x[N_ACC_SAMPLES] = {0};
-static double sample_pp_r[N_ACC_SAMPLES] = {0};
+static slide_window_t slide = {0};
+static const act_tree_node_t *tree_nodes = act_tree;
+static uint8_t tree_depth = ACT_TREE_DEPTH;
 
 static inline bool is_valid_sample(imu_axis_t *sample);
 static void reset_activity_parameters(void);
-static void adapt_axis(garment_id_e garment, acc_axis_t *acc);
-static void act_algo_preprocess(acc_axis_t *raw, uint8_t sample_number);
+static inline float act_acosf(float x);
+static void slot_deque_push(slot_deque_t *dq, const float *values, uint8_t slot, bool keep_max);
+static void slot_deque_expire(slot_deque_t *dq, uint8_t slot);
+static void slide_resync(void);
+static void slide_add_sample(void);
+static void act_algo_preprocess(const imu_axis_t *axis, uint16_t sample_number);
+static inline uint8_t act_tree_step(const act_tree_node_t *node, const float *features);
 static activity_t act_algo_uncalibrated_model(void);
+static bool act_tree_is_valid(const act_tree_node_t *tree, uint16_t n_nodes, uint8_t steps);
 
 /*
  * @brief  This function resets the all the activity parameters.
@@ -67,7 +112,7 @@ static activity_t act_algo_uncalibrated_model(void);
  */
 static void reset_activity_parameters(void)
 {
-    rawaxis = (acc_axis_t){0, 0, 0, 0, false};
+    rawaxis = (acc_axis_t){0, false};
 
     activity.current = ACT_UNKNOWN;
     activity.time_detected = 0;
@@ -78,6 +123,12 @@ static void reset_activity_parameters(void)
     algo_input.r_p2p = 0;
     algo_input.theta = 0;
     algo_input.theta_mean = 0;
+    algo_input.accx_m2 = 0;
+    algo_input.theta_sum = 0;
+    algo_input.r_max = 0;
+    algo_input.r_min = 0;
+
+    memset(&slide, 0, sizeof(slide));
 }
 
 static inline bool is_valid_sample(imu_axis_t *sample)
@@ -92,114 +143,300 @@ static inline bool is_valid_sample(imu_axis_t *sample)
 }
 
 /*
- * @brief  This function adjust the axis of IMU for the algorithm.
- * @param  garment id: defines which garment is configured
- * @details The axis of IMU is updated depending upon the garment type.
- * @retval this function updates the axis.
+ * @brief  This function takes one step down the decision tree.
+ * @details NaN features take the "greater" child, as the former nested ifs did.
+ * @retval index of the next node, the same node for a leaf
  */
-static void adapt_axis(garment_id_e garment, acc_axis_t *acc)
+static inline uint8_t act_tree_step(const act_tree_node_t *node, const float *features)
 {
-    int16_t temp16 = 0;
-
-    if ((garment == GARMENT_BRA_TANK) || (garment == GARMENT_BRALETTE))
-    {
-        acc->x = -1 * acc->x;
-        acc->z = -1 * acc->z;
-    }
-    else if (garment == GARMENT_CHEST_BAND)
-    {
-        temp16 = acc->x;
-        acc->x = -1 * acc->y;
-        acc->y = temp16;
-    }
+    return node->child[!(features[node->feature] <= node->threshold)];
 }
 
 /*
  * @brief  This is a algorithm model. The THRESHOLD values are uncalibrated.
- * @details Depending upon the threshold values the current activity is detected.
+ * @details The decision tree from activity_tree.h, or the one loaded with
+ *          act_set_decision_tree, is walked for exactly its depth, leaves
+ *          point to themselves.
  * @retval this function returns the detected activity.
  */
 static activity_t act_algo_uncalibrated_model(void)
 {
-   activity_t algo_output_act = ACT_UNKNOWN;
+    float features[ACT_N_FEATURES] = {0};
+    uint8_t node = 0;
+
+    features[ACT_FEATURE_ACCX_MEAN] = algo_input.accx_mean;
+    features[ACT_FEATURE_ACCX_STD] = algo_input.accx_std;
+    features[ACT_FEATURE_THETA_MEAN] = algo_input.theta_mean;
+    features[ACT_FEATURE_R_P2P] = algo_input.r_p2p;
+
+    for (uint8_t d = 0; d < tree_depth; d++)
+    {
+        node = act_tree_step(&tree_nodes[node], features);
+    }
+
+    return (activity_t)tree_nodes[node].label;
+}
+
+/*
+ * @brief  This function checks that every path from the root ends in a leaf
+ *         within the given number of steps, and that every node compares a
+ *         known feature and every leaf returns an activity_t.
+ * @details Children must have a higher index than their parent, as in the
+ *          breadth first order of gen_activity_tree.py, so one pass from the
+ *          last node gives the height of every node, O(n) for any blob.
+ *          Leaves are checked too, act_tree_step keeps reading their feature.
+ * @retval true if the tree is valid
+ */
+static bool act_tree_is_valid(const act_tree_node_t *tree, uint16_t n_nodes, uint8_t steps)
+{
+    uint8_t height[256];
+    const act_tree_node_t *p = NULL;
+    uint8_t h = 0;
 
-    if (algo_input.r_p2p <= R_P2P_UPPER_THRESHOLD)
+    for (uint16_t i = n_nodes; i-- > 0;)
     {
-        if (algo_input.accx_mean <= ACCX_MEAN_UPPER_THRESHOLD)
+        p = &tree[i];
+
+        // 1) Every node, leaves included, compares a known feature
+        if (p->feature >= ACT_N_FEATURES)
         {
-            if (algo_input.r_p2p <= R_P2P_LOWER_THRESHOLD)
-            {
-                algo_output_act = ACT_SEAT_STAND;
-            }
-            else
-            {
-                algo_output_act = ACT_SEAT_STAND;
-            }
+            return false;
         }
-        else
+
+        // 2) Leaves point to themselves and return an activity_t
+        if ((p->child[0] == i) && (p->child[1] == i))
         {
-            if (algo_input.theta_mean <= THETA_MEAN_THRESHOLD)
-            {
-                algo_output_act = ACT_SEAT_STAND;
-            }
-            else
+            if (p->label > ACT_RESERVED4)
             {
-                algo_output_act = ACT_LYING;
+                return false;
             }
+            height[i] = 0;
+            continue;
+        }
+
+        // 3) Inner nodes point forward, inside the table
+        if ((p->child[0] <= i) || (p->child[1] <= i) ||
+            (p->child[0] >= n_nodes) || (p->child[1] >= n_nodes))
+        {
+            return false;
         }
+
+        // 4) One more step than the higher child
+        h = (height[p->child[0]] > height[p->child[1]]) ? height[p->child[0]] : height[p->child[1]];
+        height[i] = h + 1;
     }
-    else
+
+    return height[0] <= steps;
+}
+
+/*
+ * @brief  This function approximates acos with the polynomial of Abramowitz
+ *         & Stegun 4.4.45, acos(x) = sqrt(1 - x) * p(x) for 0 <= x <= 1.
+ * @param  x - cosine of the angle, clamped to [-1, 1]
+ * @details Absolute error is below 7e-5 rad, far under the resolution of the
+ *          theta_mean thresholds, at the cost of one sqrtf and 3 multiply-adds.
+ * @retval angle in radians, from 0 to pi
+ */
+static inline float act_acosf(float x)
+{
+    float ax = fabsf(x);
+    float p  = 0;
+
+    if (ax > 1.0f)
     {
-        if (algo_input.accx_std <= ACCX_STD_THRESHOLD)
+        ax = 1.0f;
+    }
+
+    p = ((-0.0187293f * ax + 0.0742610f) * ax - 0.2121144f) * ax + 1.5707288f;
+    p = p * sqrtf(1.0f - ax);
+
+    return (x < 0.0f) ? (ACT_PI - p) : p;
+}
+
+/*
+ * @brief  This function adds a window slot at the back of a monotonic deque.
+ * @param  dq - deque to update
+ * @param  values - window values indexed by slot, values[slot] already written
+ * @param  slot - slot of the new sample
+ * @param  keep_max - true to track the maximum, false for the minimum
+ * @details Samples at the back that can no longer be the extreme while the new
+ *          one is in the window are dropped, so each sample is pushed and
+ *          popped at most once, O(1) amortized.
+ */
+static void slot_deque_push(slot_deque_t *dq, const float *values, uint8_t slot, bool keep_max)
+{
+    float v = values[slot];
+    float back = 0;
+
+    // 1) Drop the dominated samples from the back
+    while (dq->count > 0)
+    {
+        back = values[dq->slot[(dq->head + dq->count - 1) % N_ACC_SAMPLES]];
+        if (keep_max ? (back > v) : (back < v))
         {
-            if (algo_input.accx_mean <= ACCX_MEAN_LOWER_THRESHOLD)
-            {
-                algo_output_act = ACT_WALKING;
-            }
-            else
-            {
-                algo_output_act = ACT_WALKING;
-            }
+            break;
         }
-        else
+        dq->count--;
+    }
+
+    // 2) Add the new sample
+    dq->slot[(dq->head + dq->count) % N_ACC_SAMPLES] = slot;
+    dq->count++;
+}
+
+/*
+ * @brief  This function removes the front of a monotonic deque if it is the
+ *         sample leaving the window.
+ * @param  dq - deque to update
+ * @param  slot - slot of the sample leaving the window
+ */
+static void slot_deque_expire(slot_deque_t *dq, uint8_t slot)
+{
+    if ((dq->count > 0) && (dq->slot[dq->head] == slot))
+    {
+        dq->head = (dq->head + 1) % N_ACC_SAMPLES;
+        dq->count--;
+    }
+}
+
+/*
+ * @brief  This function recomputes the sliding window sums from the samples.
+ * @details Bounds the rounding drift of the add/remove updates; called every
+ *          SLIDE_RESYNC_SAMPLES samples, so it stays O(1) amortized.
+ */
+static void slide_resync(void)
+{
+    float sum = 0;
+    float theta_sum = 0;
+    float m2 = 0;
+
+    for (uint8_t i = 0; i < slide.count; i++)
+    {
+        sum += slide.x[i];
+        theta_sum += slide.theta[i];
+    }
+
+    slide.accx_mean = sum / slide.count;
+    for (uint8_t i = 0; i < slide.count; i++)
+    {
+        m2 += (slide.x[i] - slide.accx_mean) * (slide.x[i] - slide.accx_mean);
+    }
+
+    slide.accx_m2 = m2;
+    slide.theta_sum = theta_sum;
+    slide.resync = 0;
+}
+
+/*
+ * @brief  This function adds the pre-processed sample to the sliding window.
+ * @details Once the window is full the oldest sample is replaced: the mean
+ *          and M2 of x use the fixed length update
+ *          mean' = mean + (x - x_old) / N,
+ *          M2'   = M2 + (x - x_old) * (x - mean' + x_old - mean),
+ *          the theta sum adds and removes, and r min/max come from monotonic
+ *          deques. While the window fills, Welford updates are used.
+ */
+static void slide_add_sample(void)
+{
+    uint8_t pos = slide.pos;
+    float x_old = slide.x[pos];
+    float mean_old = slide.accx_mean;
+    float delta = 0;
+
+    // 1) Remove the oldest sample from the deques when the window is full
+    if (slide.count == N_ACC_SAMPLES)
+    {
+        slot_deque_expire(&slide.r_max, pos);
+        slot_deque_expire(&slide.r_min, pos);
+    }
+
+    // 2) Store the new sample
+    slide.x[pos] = algo_input.raw.x;
+    slide.r[pos] = algo_input.r;
+    slide.theta_sum += algo_input.theta - ((slide.count == N_ACC_SAMPLES) ? slide.theta[pos] : 0);
+    slide.theta[pos] = algo_input.theta;
+    slide.pos = (pos + 1) % N_ACC_SAMPLES;
+
+    // 3) Update the x mean and M2
+    if (slide.count == N_ACC_SAMPLES)
+    {
+        delta = algo_input.raw.x - x_old;
+        slide.accx_mean += delta * (1.0f / N_ACC_SAMPLES);
+        slide.accx_m2   += delta * (algo_input.raw.x - slide.accx_mean + x_old - mean_old);
+        if (++slide.resync >= SLIDE_RESYNC_SAMPLES)
         {
-            algo_output_act = ACT_RUNNING;
+            slide_resync();
         }
     }
+    else
+    {
+        slide.count++;
+        delta = algo_input.raw.x - slide.accx_mean;
+        slide.accx_mean += delta / slide.count;
+        slide.accx_m2   += delta * (algo_input.raw.x - slide.accx_mean);
+    }
 
-    algo_input.accx_mean = 0;
-    algo_input.theta_mean = 0;
-
-    return algo_output_act;
+    // 4) Add the new sample to the deques
+    slot_deque_push(&slide.r_max, slide.r, pos, true);
+    slot_deque_push(&slide.r_min, slide.r, pos, false);
 }
 
 /*
  * @brief This function pre-process the x,y,z axis data which are feed to algorithm model
- * @details This function calculates the parameters needed to process activity algo.
- *          This parameters inculde's mean, theta, and r calculation.
+ * @details The IMU axes are remapped for the garment and scaled to m/s^2 in
+ *          one multiply per axis, without branches.
+ *          This function calculates the parameters needed to process activity algo.
+ *          This parameters inculde's mean, theta, and r calculation. The window
+ *          features are updated per sample (Welford mean and variance of x,
+ *          theta sum, r min and max) and restart on the first sample of a
+ *          window, so no samples are buffered.
  * @retval This function updates algo_pp_t structure.
  */
-static void act_algo_preprocess(acc_axis_t *raw, uint8_t index_number)
+static void act_algo_preprocess(const imu_axis_t *axis, uint16_t index_number)
 {
-   algo_input.raw.x = (double) (raw->x*PREPROCESS_FACTOR);
-   algo_input.raw.y = (double) (raw->y*PREPROCESS_FACTOR);
-   algo_input.raw.z = (double) (raw->z*PREPROCESS_FACTOR) * (-1);
-   algo_input.r     = sqrt((algo_input.raw.x*algo_input.raw.x) +
+   const int16_t in[3] = {axis->x, axis->y, axis->z};
+   float delta = 0;
+
+   algo_input.raw.x = (float) in[remap->src[0]] * remap->scale[0];
+   algo_input.raw.y = (float) in[remap->src[1]] * remap->scale[1];
+   algo_input.raw.z = (float) in[remap->src[2]] * remap->scale[2];
+   algo_input.r     = sqrtf((algo_input.raw.x*algo_input.raw.x) +
                         (algo_input.raw.y*algo_input.raw.y) +
                         (algo_input.raw.z*algo_input.raw.z));
 
-   algo_input.theta = acos(algo_input.raw.x/algo_input.r);
-   algo_input.accx_mean  += algo_input.raw.x;
-   algo_input.theta_mean += algo_input.theta;
+   // A zero magnitude glitch has no angle, pi/2 keeps the sums finite
+   algo_input.theta = act_acosf((algo_input.r > 0.0f) ? (algo_input.raw.x / algo_input.r) : 0.0f);
+
+   if (slide_hop != 0)
+   {
+       slide_add_sample();
+       return;
+   }
 
-   if (index_number >= (N_ACC_SAMPLES - 1))
+   if (index_number == 0)
    {
-       algo_input.accx_mean  = algo_input.accx_mean/N_ACC_SAMPLES;
-       algo_input.theta_mean = algo_input.theta_mean/N_ACC_SAMPLES;
+       algo_input.accx_mean = algo_input.raw.x;
+       algo_input.accx_m2   = 0;
+       algo_input.theta_sum = algo_input.theta;
+       algo_input.r_max     = algo_input.r;
+       algo_input.r_min     = algo_input.r;
+       return;
    }
 
-   sample_pp_x[index_number] = algo_input.raw.x;
-   sample_pp_r[index_number] = algo_input.r;
+   delta = algo_input.raw.x - algo_input.accx_mean;
+   algo_input.accx_mean += delta / (float)(index_number + 1);
+   algo_input.accx_m2   += delta * (algo_input.raw.x - algo_input.accx_mean);
+   algo_input.theta_sum += algo_input.theta;
+
+   if (algo_input.r > algo_input.r_max)
+   {
+       algo_input.r_max = algo_input.r;
+   }
+
+   if (algo_input.r < algo_input.r_min)
+   {
+       algo_input.r_min = algo_input.r;
+   }
 }
 
 void act_init(void)
@@ -225,12 +462,7 @@ void act_add_raw_acc(imu_axis_t axis)
     }
 
     //activity task is not processing the posture
-    rawaxis.x = axis.x;
-    rawaxis.y = axis.y;
-    rawaxis.z = axis.z;
-
-    adapt_axis(GARMENT_ID_DEFAULT, &rawaxis);
-    act_algo_preprocess(&rawaxis,rawaxis.samples);
+    act_algo_preprocess(&axis,rawaxis.samples);
 
     rawaxis.samples++;
 
@@ -246,39 +478,44 @@ void act_add_raw_acc(imu_axis_t axis)
 /*
  * @brief  This function finds the standard deviation and peak to peak values from
  *         x - axis data.
- * @details Finds r peak to peak and std values form  x- axis data.
+ * @details Finishes the features accumulated by act_algo_preprocess, O(1)
+ *          whatever the window length.
  * @retval this function updates algo_pp_t structure.
  */
 activity_t process_act_algo(void)
 {
     activity_t detected_act = ACT_UNKNOWN;
-    float r_max = 0;
-    float r_min = 0;
-    float std = 0;
-
-    rawaxis.samples = 0; // XXX - added here clear sample count
+    float n_inv = 0;
 
-    r_max = r_min = sample_pp_r[0]; // to avoid error
-
-    for(uint8_t i = 0; i < N_ACC_SAMPLES; i++)
+    if (rawaxis.samples == 0)
     {
+        return ACT_UNKNOWN;
+    }
 
-        std += (sample_pp_x[i] - algo_input.accx_mean) *
-            (sample_pp_x[i] - algo_input.accx_mean);// to avoid type casting
-
-        if (sample_pp_r[i] > r_max )
+    if (slide_hop != 0)
+    {
+        if (slide.count < N_ACC_SAMPLES)
         {
-            r_max = sample_pp_r[i];
+            return ACT_UNKNOWN;
         }
 
-        if (sample_pp_r[i] < r_min)
-        {
-            r_min = sample_pp_r[i];
-        }
+        rawaxis.samples = 0;
+
+        algo_input.accx_mean = slide.accx_mean;
+        algo_input.accx_std = sqrtf(((slide.accx_m2 > 0) ? slide.accx_m2 : 0) * (1.0f / N_ACC_SAMPLES));
+        algo_input.theta_mean = slide.theta_sum * (1.0f / N_ACC_SAMPLES);
+        algo_input.r_p2p = slide.r[slide.r_max.slot[slide.r_max.head]] -
+                           slide.r[slide.r_min.slot[slide.r_min.head]];
+
+        return act_algo_uncalibrated_model();
     }
 
-    algo_input.accx_std = sqrt(std/N_ACC_SAMPLES);
-    algo_input.r_p2p = r_max - r_min;
+    n_inv = 1.0f / rawaxis.samples;
+    rawaxis.samples = 0; // XXX - added here clear sample count
+
+    algo_input.accx_std = sqrtf(algo_input.accx_m2 * n_inv);
+    algo_input.theta_mean = algo_input.theta_sum * n_inv;
+    algo_input.r_p2p = algo_input.r_max - algo_input.r_min;
     detected_act = act_algo_uncalibrated_model();
 
     return detected_act;
@@ -287,4 +524,204 @@ activity_t process_act_algo(void)
 uint16_t act_get_samples_count(void)
 {
     return rawaxis.samples;
-}
\ No newline at end of file
+}
+
+/*
+ * @brief  This function selects the garment the IMU axes are remapped for.
+ * @param  garment - the garment ID, represents which garment is used
+ * @details The remap is looked up once here instead of per sample.
+ */
+void act_set_garment(garment_id_e garment)
+{
+    if (garment >= MAX_GARMENTS)
+    {
+        return;
+    }
+
+    remap = &garment_remap[garment];
+}
+
+/*
+ * @brief  This function selects disjoint or sliding windows.
+ * @param  hop - samples between two classifications of the last N_ACC_SAMPLES
+ *         samples, 0 for disjoint windows of N_ACC_SAMPLES (default)
+ * @details Clears the window in progress, the setting is kept by act_init.
+ */
+void act_set_sliding_window(uint16_t hop)
+{
+    slide_hop = hop;
+    rawaxis.samples = 0;
+    memset(&slide, 0, sizeof(slide));
+}
+
+/*
+ * @brief  This function tells if process_act_algo has a new window to classify.
+ * @retval true after N_ACC_SAMPLES samples for disjoint windows, or after hop
+ *         samples once the sliding window is full
+ */
+bool act_is_window_ready(void)
+{
+    if (slide_hop != 0)
+    {
+        return (slide.count >= N_ACC_SAMPLES) && (rawaxis.samples >= slide_hop);
+    }
+
+    return rawaxis.samples >= N_ACC_SAMPLES;
+}
+
+/*
+ * @brief  This function replaces the decision tree, e.g. with a retrained one
+ *         loaded from a binary blob.
+ * @param  tree - nodes in the act_tree_node_t layout, root first and children
+ *         after their parent; the array is used in place and must stay valid
+ * @param  n_nodes - number of nodes, up to 256
+ * @param  depth - steps from the root to the deepest leaf
+ * @retval true if the tree is rejected, the current tree is kept
+ */
+bool act_set_decision_tree(const act_tree_node_t *tree, uint16_t n_nodes, uint8_t depth)
+{
+    if ((tree == NULL) || (n_nodes == 0) || (n_nodes > 256) ||
+        !act_tree_is_valid(tree, n_nodes, depth))
+    {
+        return true;
+    }
+
+    tree_nodes = tree;
+    tree_depth = depth;
+
+    return false;
+}
+
+/*
+ * @brief  This function classifies many windows from their features.
+ * @param  features - features of each window, indexed by act_feature_e
+ * @param  n_windows - number of windows
+ * @param  out - activity of each window
+ * @details Blocks of ACT_BATCH_WINDOWS windows are walked down the tree one
+ *          level at a time, every window takes the same number of steps so
+ *          the loops have no data dependent branches.
+ */
+void act_classify_windows(const float (*features)[ACT_N_FEATURES], uint32_t n_windows, activity_t *out)
+{
+    uint8_t node[ACT_BATCH_WINDOWS];
+    uint32_t n = 0;
+
+    for (uint32_t w = 0; w < n_windows; w += n)
+    {
+        n = ((n_windows - w) < ACT_BATCH_WINDOWS) ? (n_windows - w) : ACT_BATCH_WINDOWS;
+        memset(node, 0, sizeof(node));
+
+        for (uint8_t d = 0; d < tree_depth; d++)
+        {
+            for (uint32_t i = 0; i < n; i++)
+            {
+                node[i] = act_tree_step(&tree_nodes[node[i]], features[w + i]);
+            }
+        }
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+            out[w + i] = (activity_t)tree_nodes[node[i]].label;
+        }
+    }
+}
+
+/*
+ * @brief  This function classifies a recording given as separate x, y and z
+ *         arrays, in disjoint windows of N_ACC_SAMPLES samples.
+ * @param  x, y, z - raw IMU axes of the recording, in counts
+ * @param  n_samples - samples per axis, a last partial window is ignored
+ * @param  out - activity of each window, n_samples / N_ACC_SAMPLES entries
+ * @param  scratch - working memory, kept out of the firmware RAM
+ * @details The garment and decision tree currently set are used, the sample
+ *          state of act_add_raw_acc is not touched. Each block of windows goes
+ *          through contiguous loops without branches: remap, magnitude and
+ *          angle over all its samples, then the window features, then the
+ *          tree, so the compiler vectorizes them across samples and windows
+ *          (build with -fno-math-errno so sqrtf vectorizes).
+ * @retval number of windows classified, 0 without scratch
+ */
+uint32_t act_process_batch(const int16_t *x, const int16_t *y, const int16_t *z, uint32_t n_samples, activity_t *out, act_batch_scratch_t *scratch)
+{
+    const int16_t *axes[3] = {x, y, z};
+    const int16_t *ax = axes[remap->src[0]];
+    const int16_t *ay = axes[remap->src[1]];
+    const int16_t *az = axes[remap->src[2]];
+    const float sx = remap->scale[0];
+    const float sy = remap->scale[1];
+    const float sz = remap->scale[2];
+    uint32_t n_windows = n_samples / N_ACC_SAMPLES;
+    uint32_t n = 0;
+    float *batch_x = NULL;
+    float *batch_r = NULL;
+    float *batch_theta = NULL;
+
+    if (scratch == NULL)
+    {
+        return 0;
+    }
+
+    batch_x = scratch->x;
+    batch_r = scratch->r;
+    batch_theta = scratch->theta;
+
+    for (uint32_t w = 0; w < n_windows; w += n)
+    {
+        const int16_t *bx = &ax[w * N_ACC_SAMPLES];
+        const int16_t *by = &ay[w * N_ACC_SAMPLES];
+        const int16_t *bz = &az[w * N_ACC_SAMPLES];
+
+        n = ((n_windows - w) < ACT_BATCH_WINDOWS) ? (n_windows - w) : ACT_BATCH_WINDOWS;
+
+        // 1) Remapped x, magnitude and angle of every sample of the block
+        for (uint32_t i = 0; i < n * N_ACC_SAMPLES; i++)
+        {
+            float fx = (float) bx[i] * sx;
+            float fy = (float) by[i] * sy;
+            float fz = (float) bz[i] * sz;
+            float r = sqrtf((fx * fx) + (fy * fy) + (fz * fz));
+
+            batch_x[i] = fx;
+            batch_r[i] = r;
+            batch_theta[i] = act_acosf((r > 0.0f) ? (fx / r) : 0.0f);
+        }
+
+        // 2) Features of every window of the block
+        for (uint32_t k = 0; k < n; k++)
+        {
+            const float *px = &batch_x[k * N_ACC_SAMPLES];
+            const float *pr = &batch_r[k * N_ACC_SAMPLES];
+            const float *pt = &batch_theta[k * N_ACC_SAMPLES];
+            float sum = 0;
+            float theta_sum = 0;
+            float m2 = 0;
+            float mean = 0;
+            float r_max = pr[0];
+            float r_min = pr[0];
+
+            for (uint8_t j = 0; j < N_ACC_SAMPLES; j++)
+            {
+                sum += px[j];
+                theta_sum += pt[j];
+                r_max = (pr[j] > r_max) ? pr[j] : r_max;
+                r_min = (pr[j] < r_min) ? pr[j] : r_min;
+            }
+
+            mean = sum * (1.0f / N_ACC_SAMPLES);
+            for (uint8_t j = 0; j < N_ACC_SAMPLES; j++)
+            {
+                m2 += (px[j] - mean) * (px[j] - mean);
+            }
+
+            scratch->features[k][ACT_FEATURE_ACCX_MEAN] = mean;
+            scratch->features[k][ACT_FEATURE_ACCX_STD] = sqrtf(m2 * (1.0f / N_ACC_SAMPLES));
+            scratch->features[k][ACT_FEATURE_THETA_MEAN] = theta_sum * (1.0f / N_ACC_SAMPLES);
+            scratch->features[k][ACT_FEATURE_R_P2P] = r_max - r_min;
+        }
+
+        // 3) Activity of every window of the block
+        act_classify_windows((const float (*)[ACT_N_FEATURES])scratch->features, n, &out[w]);
+    }
+
+    return n_windows;
+}
@@ -5,6 +5,7 @@
 #include <stdint.h>
 
 #define N_ACC_SAMPLES   12  // Number of samples to accumulate before calculating the posture
+#define ACT_BATCH_WINDOWS   64  // Windows processed together in batch
 
 /// XXX - Added here for standalone application
 typedef struct
@@ -44,6 +45,35 @@ typedef enum
     ACT_RESERVED4   = 12,
 }activity_t;
 
+// Window features the decision tree compares against its thresholds
+typedef enum
+{
+    ACT_FEATURE_ACCX_MEAN   = 0,
+    ACT_FEATURE_ACCX_STD    = 1,
+    ACT_FEATURE_THETA_MEAN  = 2,
+    ACT_FEATURE_R_P2P       = 3,
+    //do not define features below
+    ACT_N_FEATURES,
+}act_feature_e;
+
+// Decision tree node, see gen_activity_tree.py. Leaves point to themselves.
+typedef struct
+{
+    uint8_t feature;            // act_feature_e compared to the threshold
+    float threshold;
+    uint8_t child[2];           // Next node if feature <= threshold, otherwise
+    uint8_t label;              // activity_t of a leaf
+}act_tree_node_t;
+
+// Working memory of act_process_batch, provided by the caller (host tools)
+typedef struct
+{
+    float x[ACT_BATCH_WINDOWS * N_ACC_SAMPLES];
+    float r[ACT_BATCH_WINDOWS * N_ACC_SAMPLES];
+    float theta[ACT_BATCH_WINDOWS * N_ACC_SAMPLES];
+    float features[ACT_BATCH_WINDOWS][ACT_N_FEATURES];
+}act_batch_scratch_t;
+
 typedef struct
 {
     uint32_t time_detected;     // Detection time 
@@ -54,5 +84,11 @@ void act_init(void);
 void act_add_raw_acc(imu_axis_t axis);
 activity_t process_act_algo(void);
 uint16_t act_get_samples_count(void);
+void act_set_garment(garment_id_e garment);
+void act_set_sliding_window(uint16_t hop);
+bool act_set_decision_tree(const act_tree_node_t *tree, uint16_t n_nodes, uint8_t depth);
+void act_classify_windows(const float (*features)[ACT_N_FEATURES], uint32_t n_windows, activity_t *out);
+uint32_t act_process_batch(const int16_t *x, const int16_t *y, const int16_t *z, uint32_t n_samples, activity_t *out, act_batch_scratch_t *scratch);
+bool act_is_window_ready(void);
 
 #endif /* SRC_ALGORITHMS_ACTIVITY_H_ */
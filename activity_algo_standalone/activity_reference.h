@@ -0,0 +1,13 @@
+#ifndef SRC_ALGORITHMS_ACTIVITY_REFERENCE_H_
+#define SRC_ALGORITHMS_ACTIVITY_REFERENCE_H_
+
+#include "activity.h"
+
+// Double precision activity algorithm, kept as the reference for act_bench.c
+void act_ref_init(void);
+void act_ref_add_raw_acc(imu_axis_t axis);
+activity_t process_act_ref_algo(void);
+uint16_t act_ref_get_samples_count(void);
+void act_ref_set_garment(garment_id_e garment);
+
+#endif /* SRC_ALGORITHMS_ACTIVITY_REFERENCE_H_ */
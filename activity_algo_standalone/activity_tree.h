@@ -0,0 +1,28 @@
+// Activity decision tree 'uncalibrated'.
+//
+// Generated by gen_activity_tree.py from
+// activity_tree.json.
+// Do not edit; re-run the generator whenever data science provides a new
+// tree.
+#ifndef SRC_ALGORITHMS_ACTIVITY_TREE_H_
+#define SRC_ALGORITHMS_ACTIVITY_TREE_H_
+
+#include "activity.h"
+
+#define ACT_TREE_NODES  9
+#define ACT_TREE_DEPTH  3
+
+static const act_tree_node_t act_tree[ACT_TREE_NODES] =
+{
+    {ACT_FEATURE_R_P2P, 1.00206f, {1, 2}, ACT_UNKNOWN},  // node 0
+    {ACT_FEATURE_ACCX_MEAN, -4.5201f, {3, 4}, ACT_UNKNOWN},  // node 1
+    {ACT_FEATURE_ACCX_STD, 5.999058f, {5, 6}, ACT_UNKNOWN},  // node 2
+    {ACT_FEATURE_ACCX_MEAN, 0.0f, {3, 3}, ACT_SEAT_STAND},  // node 3, leaf
+    {ACT_FEATURE_THETA_MEAN, 1.101531f, {7, 8}, ACT_UNKNOWN},  // node 4
+    {ACT_FEATURE_ACCX_MEAN, 0.0f, {5, 5}, ACT_WALKING},  // node 5, leaf
+    {ACT_FEATURE_ACCX_MEAN, 0.0f, {6, 6}, ACT_RUNNING},  // node 6, leaf
+    {ACT_FEATURE_ACCX_MEAN, 0.0f, {7, 7}, ACT_SEAT_STAND},  // node 7, leaf
+    {ACT_FEATURE_ACCX_MEAN, 0.0f, {8, 8}, ACT_LYING},  // node 8, leaf
+};
+
+#endif /* SRC_ALGORITHMS_ACTIVITY_TREE_H_ */
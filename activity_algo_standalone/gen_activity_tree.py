@@ -0,0 +1,128 @@
+"""Decision tree header generator for the activity algorithm.
+
+Reads a decision tree exported by data science as JSON and writes
+``activity_tree.h``, the node table evaluated by ``activity.c``. Inner nodes
+are ``{"feature": <name>, "threshold": <value>, "le": <node>, "gt": <node>}``
+and take ``le`` when the feature is less than or equal to the threshold;
+leaves are ``{"class": <activity_t name>}``.
+
+Inner nodes whose two subtrees end in the same class are collapsed into a
+leaf. Nodes are numbered breadth first from the root, and every leaf points
+to itself, so the evaluator walks exactly ``ACT_TREE_DEPTH`` steps whatever
+the path.
+
+Only the Python standard library is used.
+
+Usage::
+
+    python gen_activity_tree.py                    # activity_tree.json
+    python gen_activity_tree.py retrained.json     # another export
+    python gen_activity_tree.py --dry-run          # only report the tree
+"""
+
+import argparse
+import json
+import pathlib
+
+file_dir = pathlib.Path(__file__).parent
+
+# Feature names, in the order of act_feature_e in activity.h
+FEATURES = ["accx_mean", "accx_std", "theta_mean", "r_p2p"]
+MAX_NODES = 256  # child indices are uint8_t
+
+
+def prune(node):
+    """Collapse subtrees that always give the same class."""
+    if "class" in node:
+        return node
+    le = prune(node["le"])
+    gt = prune(node["gt"])
+    if "class" in le and "class" in gt and le["class"] == gt["class"]:
+        return le
+    return dict(node, le=le, gt=gt)
+
+
+def flatten(root):
+    """Number the nodes breadth first and return them with the tree depth."""
+    nodes = []
+    queue = [(root, 0)]
+    depth = 0
+    while queue:
+        node, level = queue.pop(0)
+        depth = max(depth, level)
+        nodes.append(node)
+        if "class" not in node:
+            if node["feature"] not in FEATURES:
+                raise SystemExit(f"unknown feature {node['feature']!r}")
+            queue += [(node["le"], level + 1), (node["gt"], level + 1)]
+    if len(nodes) > MAX_NODES:
+        raise SystemExit(f"{len(nodes)} nodes, at most {MAX_NODES} supported")
+
+    index = {id(node): i for i, node in enumerate(nodes)}
+    table = []
+    for i, node in enumerate(nodes):
+        if "class" in node:
+            table.append(("ACT_FEATURE_ACCX_MEAN", "0.0f", i, i, node["class"]))
+        else:
+            table.append(
+                (
+                    "ACT_FEATURE_" + node["feature"].upper(),
+                    f"{float(node['threshold'])!r}f",
+                    index[id(node["le"])],
+                    index[id(node["gt"])],
+                    "ACT_UNKNOWN",
+                )
+            )
+    return table, depth
+
+
+def header(source, name, table, depth):
+    lines = [
+        f"// Activity decision tree '{name}'.",
+        "//",
+        "// Generated by gen_activity_tree.py from",
+        f"// {source.name}.",
+        "// Do not edit; re-run the generator whenever data science provides a new",
+        "// tree.",
+        "#ifndef SRC_ALGORITHMS_ACTIVITY_TREE_H_",
+        "#define SRC_ALGORITHMS_ACTIVITY_TREE_H_",
+        "",
+        '#include "activity.h"',
+        "",
+        f"#define ACT_TREE_NODES  {len(table)}",
+        f"#define ACT_TREE_DEPTH  {depth}",
+        "",
+        "static const act_tree_node_t act_tree[ACT_TREE_NODES] =",
+        "{",
+    ]
+    for i, (feature, threshold, le, gt, label) in enumerate(table):
+        comment = f"node {i}, leaf" if le == gt == i else f"node {i}"
+        lines.append(
+            f"    {{{feature}, {threshold}, {{{le}, {gt}}}, {label}}},  // {comment}"
+        )
+    lines += ["};", "", "#endif /* SRC_ALGORITHMS_ACTIVITY_TREE_H_ */", ""]
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Activity decision tree generator")
+    parser.add_argument("tree", nargs="?", default=file_dir / "activity_tree.json")
+    parser.add_argument(
+        "--dry-run", action="store_true", help="report only, do not write the header"
+    )
+    args = parser.parse_args()
+
+    source = pathlib.Path(args.tree)
+    export = json.loads(source.read_text())
+    table, depth = flatten(prune(export["tree"]))
+    leaves = sum(1 for i, row in enumerate(table) if row[2] == row[3] == i)
+    print(f"{export['name']}: {len(table)} nodes, {leaves} leaves, depth {depth}")
+
+    if not args.dry_run:
+        out_path = file_dir / "activity_tree.h"
+        out_path.write_text(header(source, export["name"], table, depth))
+        print(f"  wrote {out_path.name}")
+
+
+if __name__ == "__main__":
+    main()
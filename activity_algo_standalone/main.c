@@ -5,6 +5,9 @@
 #include "activity.h"
 #include "input.h"
 
+#define ACT_GARMENT_ID      GARMENT_UNDERWEAR   // Garment the IMU axes are remapped for
+#define ACT_SLIDING_HOP     0   // Samples between outputs of a sliding window, 0 for disjoint windows
+
 int main(int argc, char const *argv[])
 {
     imu_axis_t acc = {0};
@@ -17,6 +20,8 @@ int main(int argc, char const *argv[])
     // Initialize and enable the activity algorithm
     printf("Initializing and enabling the activity algorithm...\r\n");
     act_init();
+    act_set_garment(ACT_GARMENT_ID);
+    act_set_sliding_window(ACT_SLIDING_HOP);
 
     // Loop through entire input array
     printf("Looping through input data...\r\n\r\n");
@@ -32,7 +37,7 @@ int main(int argc, char const *argv[])
        
         // Check if enough samples were captured internally
 
-        if (act_get_samples_count() > (N_ACC_SAMPLES - 1))
+        if (act_is_window_ready())
         {
             // Process data through algorithm
             current_act = process_act_algo();
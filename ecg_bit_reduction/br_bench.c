@@ -0,0 +1,310 @@
+#include "ecg_bit_reduction.h"
+#include "ecg_bit_reduction_reference.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_SAMPLES           (320 * 60 * 60)     // One hour at 320 Hz per channel
+#define BENCH_FS                320.0               // ECG sample rate in Hz
+#define BENCH_BASELINE          8000000.0           // ADC counts at 0 mV
+#define BENCH_COUNTS_PER_MV     11666.0             // See BR_THRESHOLD_SUCCESSIVE_DIFF
+#define BENCH_MAX_DIFF          1                   // Floor boundary cases, in output LSBs
+#define BENCH_MAX_MISMATCH      20                  // Samples per allowed mismatch, the double
+                                                    // filter itself is ~1 count off (DC leak)
+#define BENCH_PACKET_SAMPLES    24                  // Samples per channel in a packet
+#define BENCH_CLIP_HIGH         1562                // Fixed mode output at the MSB threshold
+#define BENCH_CLIP_LOW          -1563
+#define BENCH_LSB               128.0               // ADC counts per fixed mode LSB, 2^BR_LSB_TO_REMOVE
+
+typedef struct
+{
+    const char *pName;
+    int16_t (*reduce)(uint32_t bSample, ecg_sens_id nECGId, bool fRestart);
+} bench_br_t;
+
+static const bench_br_t tInteger   = {"integer", ECGBitReduction_SampleReduction};
+static const bench_br_t tReference = {"double",  ECGBitReductionRef_SampleReduction};
+
+static volatile int16_t bSink = 0;
+static uint32_t dwSeed = 1;
+
+static double bench_random(void)
+{
+    dwSeed = dwSeed * 1664525u + 1013904223u;
+
+    return (double)(dwSeed >> 8) * (1.0 / 16777216.0);
+}
+
+/*
+ * @brief  This function loads raw ADC samples, one per line, into ECG1; the
+ *         other channels get the same samples.
+ * @retval true if the file can not be read
+ */
+static bool bench_load(uint32_t **ppSamples, size_t *pnSamples, const char *pPath)
+{
+    FILE    *pFile    = fopen(pPath, "r");
+    uint32_t *pData   = NULL;
+    size_t   nSize    = 0;
+    size_t   n        = 0;
+    double   dSample  = 0;
+
+    if (pFile == NULL)
+    {
+        return true;
+    }
+
+    while (fscanf(pFile, " %lf", &dSample) == 1)
+    {
+        if (n >= nSize)
+        {
+            nSize = (nSize + 1) * 2;
+            pData = (uint32_t *)realloc(pData, nSize * MAX_ECG * sizeof(uint32_t));
+            if (pData == NULL)
+            {
+                fclose(pFile);
+                return true;
+            }
+        }
+        for (int ch = 0; ch < MAX_ECG; ch++)
+        {
+            pData[n * MAX_ECG + ch] = (uint32_t)dSample;
+        }
+        n++;
+    }
+    fclose(pFile);
+
+    *ppSamples = pData;
+    *pnSamples = n;
+
+    return n == 0;
+}
+
+/*
+ * @brief  This function synthesizes interleaved raw ADC samples of the 3 ECG
+ *         channels: baseline wander, QRS-like pulses, mains and noise, with
+ *         electrode motion steps about once a minute that trigger the filter
+ *         restart logic.
+ * @retval true on allocation failure
+ */
+static bool bench_synthesize(uint32_t **ppSamples, size_t *pnSamples)
+{
+    uint32_t *pData     = (uint32_t *)malloc((size_t)BENCH_SAMPLES * MAX_ECG * sizeof(uint32_t));
+    double    pdStep[MAX_ECG] = {0};
+    double    t         = 0;
+    double    dPhase    = 0;
+    double    dMV       = 0;
+
+    if (pData == NULL)
+    {
+        return true;
+    }
+
+    for (size_t i = 0; i < BENCH_SAMPLES; i++)
+    {
+        t      = (double)i / BENCH_FS;
+        dPhase = fmod(t * 1.2, 1.0);
+        for (int ch = 0; ch < MAX_ECG; ch++)
+        {
+            if (bench_random() < 1.0 / (BENCH_FS * 60.0))
+            {
+                pdStep[ch] = 80.0 * (bench_random() - 0.5);
+            }
+            dMV  = 2.0 * sin(2.0 * M_PI * (0.2 + 0.1 * ch) * t) + 0.1 * sin(2.0 * M_PI * 50.0 * t);
+            dMV += (1.5 - 0.4 * ch) * exp(-pow((dPhase - 0.5) / 0.01, 2.0));
+            dMV += 0.02 * (bench_random() - 0.5) + pdStep[ch];
+            pData[i * MAX_ECG + ch] = (uint32_t)(BENCH_BASELINE + dMV * BENCH_COUNTS_PER_MV);
+        }
+    }
+
+    *ppSamples = pData;
+    *pnSamples = BENCH_SAMPLES;
+
+    return false;
+}
+
+/*
+ * @brief  This function times one implementation over all channels.
+ * @retval ns per sample and channel
+ */
+static double bench_time(const bench_br_t *pBR, const uint32_t *pSamples, size_t nSamples)
+{
+    clock_t tStart = clock();
+
+    for (size_t i = 0; i < nSamples; i++)
+    {
+        for (int ch = 0; ch < MAX_ECG; ch++)
+        {
+            bSink = pBR->reduce(pSamples[i * MAX_ECG + ch], (ecg_sens_id)ch, i == 0);
+        }
+    }
+
+    return (double)(clock() - tStart) / CLOCKS_PER_SEC * 1e9 / ((double)nSamples * MAX_ECG);
+}
+
+/*
+ * @brief  This function times the packet API over all channels.
+ * @retval ns per sample and channel
+ */
+static double bench_time_packet(const uint32_t *pSamples, size_t nSamples, int16_t *pOut)
+{
+    clock_t tStart = clock();
+    size_t  n      = 0;
+
+    ECGBitReduction_Restart();
+    for (size_t i = 0; i < nSamples; i += n)
+    {
+        n = (nSamples - i < BENCH_PACKET_SAMPLES) ? nSamples - i : BENCH_PACKET_SAMPLES;
+        ECGBitReduction_ReducePacket(&pSamples[i * MAX_ECG], n, &pOut[i * MAX_ECG]);
+    }
+
+    return (double)(clock() - tStart) / CLOCKS_PER_SEC * 1e9 / ((double)nSamples * MAX_ECG);
+}
+
+int main(int argc, const char *argv[])
+{
+    uint32_t *pSamples  = NULL;
+    size_t    nSamples  = 0;
+    int16_t  *pSingle   = NULL;
+    int16_t  *pPacket   = NULL;
+    double   *pdUnclamped = NULL;
+    size_t    nMismatch = 0;
+    size_t    nPacketMismatch = 0;
+    size_t    nPackMismatch = 0;
+    size_t    nPacked   = 0;
+    size_t    nBytes    = 0;
+    uint8_t   pbPacked[ECG_BR_PACKED_SIZE(BENCH_PACKET_SAMPLES * MAX_ECG)] = {0};
+    int16_t   pbUnpacked[BENCH_PACKET_SAMPLES * MAX_ECG] = {0};
+    int16_t   pbEdges[BENCH_PACKET_SAMPLES * MAX_ECG] = {0};
+    uint8_t   pbAdaptive[ECG_BR_ADAPTIVE_SIZE(BENCH_PACKET_SAMPLES)] = {0};
+    int32_t   pbDecoded[BENCH_PACKET_SAMPLES * MAX_ECG] = {0};
+    size_t    nAdaptiveBytes = 0;
+    size_t    nAdaptiveMismatch = 0;
+    size_t    nClipped  = 0;
+    size_t    nClippedMismatch = 0;
+    double    dError    = 0;
+    int32_t   bError    = 0;
+    int32_t   bStep     = 0;
+    int       bMaxDiff  = 0;
+    int       bDiff     = 0;
+    int16_t   bInteger  = 0;
+    int16_t   bRef      = 0;
+
+    // 1) Raw ADC samples from file, or synthetic ones
+    if ((argc > 1) ? bench_load(&pSamples, &nSamples, argv[1]) : bench_synthesize(&pSamples, &nSamples))
+    {
+        printf("Can not load the ECG samples\r\n");
+        return -1;
+    }
+    printf("%s: %zu samples x %d channels\r\n", (argc > 1) ? argv[1] : "synthetic", nSamples, MAX_ECG);
+    pSingle = (int16_t *)malloc(nSamples * MAX_ECG * sizeof(int16_t));
+    pPacket = (int16_t *)malloc(nSamples * MAX_ECG * sizeof(int16_t));
+    pdUnclamped = (double *)malloc(nSamples * MAX_ECG * sizeof(double));
+    if ((pSingle == NULL) || (pPacket == NULL) || (pdUnclamped == NULL))
+    {
+        printf("Can not allocate the outputs\r\n");
+        return -1;
+    }
+
+    // 2) Integer output against the double reference
+    for (size_t i = 0; i < nSamples; i++)
+    {
+        for (int ch = 0; ch < MAX_ECG; ch++)
+        {
+            bInteger = tInteger.reduce(pSamples[i * MAX_ECG + ch], (ecg_sens_id)ch, i == 0);
+            pSingle[i * MAX_ECG + ch] = bInteger;
+            bRef     = tReference.reduce(pSamples[i * MAX_ECG + ch], (ecg_sens_id)ch, i == 0);
+            pdUnclamped[i * MAX_ECG + ch] = ECGBitReductionRef_GetFilterOutput((ecg_sens_id)ch) / BENCH_LSB;
+            bDiff    = abs(bInteger - bRef);
+            if (bDiff != 0)
+            {
+                nMismatch++;
+                bMaxDiff = (bDiff > bMaxDiff) ? bDiff : bMaxDiff;
+            }
+        }
+    }
+    printf("%zu/%zu samples differ, max difference %d LSB\r\n", nMismatch, nSamples * MAX_ECG, bMaxDiff);
+
+    // 3) Packet output against the per sample output, must be bit exact
+    bench_time_packet(pSamples, nSamples, pPacket);
+    for (size_t i = 0; i < nSamples * MAX_ECG; i++)
+    {
+        nPacketMismatch += (pPacket[i] != pSingle[i]);
+    }
+    printf("%zu/%zu packet samples differ from the per sample API\r\n", nPacketMismatch, nSamples * MAX_ECG);
+
+    // 4) Packed round trip in packets of an odd number of samples, so the
+    //    tail is covered; then the values next to the 12 bit limits
+    for (size_t i = 0; i < nSamples * MAX_ECG; i += nPacked)
+    {
+        nPacked = nSamples * MAX_ECG - i;
+        nPacked = (nPacked < BENCH_PACKET_SAMPLES * MAX_ECG) ? nPacked : BENCH_PACKET_SAMPLES * MAX_ECG - 1;
+        ECGBitReduction_Pack(&pSingle[i], nPacked, pbPacked);
+        ECGBitReduction_Unpack(pbPacked, nPacked, pbUnpacked);
+        for (size_t k = 0; k < nPacked; k++)
+        {
+            nPackMismatch += (pbUnpacked[k] != pSingle[i + k]);
+        }
+    }
+    for (size_t k = 0; k < BENCH_PACKET_SAMPLES * MAX_ECG - 1; k++)
+    {
+        pbEdges[k] = (int16_t)((k & 1) ? -2048 + (int)(k >> 1) : 2047 - (int)(k >> 1));
+    }
+    ECGBitReduction_Pack(pbEdges, BENCH_PACKET_SAMPLES * MAX_ECG - 1, pbPacked);
+    ECGBitReduction_Unpack(pbPacked, BENCH_PACKET_SAMPLES * MAX_ECG - 1, pbUnpacked);
+    for (size_t k = 0; k < BENCH_PACKET_SAMPLES * MAX_ECG - 1; k++)
+    {
+        nPackMismatch += (pbUnpacked[k] != pbEdges[k]);
+    }
+    printf("%zu samples differ after the packed round trip, %d bytes per %d samples instead of %d\r\n",
+           nPackMismatch, (int)ECG_BR_PACKED_SIZE(BENCH_PACKET_SAMPLES * MAX_ECG), BENCH_PACKET_SAMPLES * MAX_ECG,
+           (int)(BENCH_PACKET_SAMPLES * MAX_ECG * sizeof(int16_t)));
+
+    // 5) Adaptive packets against the fixed output: the same samples with the
+    //    extra LSBs of the exponent removed. Where the fixed mode clips, against
+    //    the unclamped double filter output, 1 LSB apart like in 2)
+    ECGBitReduction_Restart();
+    for (size_t i = 0; i < nSamples; i += nPacked)
+    {
+        nPacked = (nSamples - i < BENCH_PACKET_SAMPLES) ? nSamples - i : BENCH_PACKET_SAMPLES;
+        ECGBitReduction_ReducePacketAdaptive(&pSamples[i * MAX_ECG], nPacked, pbAdaptive, &nBytes);
+        nAdaptiveMismatch += ECGBitReduction_UnpackAdaptive(pbAdaptive, nBytes, nPacked, pbDecoded);
+        nAdaptiveBytes += nBytes;
+        for (size_t k = 0; k < nPacked * MAX_ECG; k++)
+        {
+            bStep  = 1 << (pbAdaptive[k % MAX_ECG] & 0x0F);
+            if ((pSingle[i * MAX_ECG + k] >= BENCH_CLIP_HIGH) || (pSingle[i * MAX_ECG + k] <= BENCH_CLIP_LOW))
+            {
+                nClipped++;
+                dError = pdUnclamped[i * MAX_ECG + k] - pbDecoded[k];
+                nClippedMismatch += (dError < -BENCH_MAX_DIFF) || (dError >= bStep + BENCH_MAX_DIFF);
+                continue;
+            }
+            bError = pSingle[i * MAX_ECG + k] - pbDecoded[k];
+            nAdaptiveMismatch += (bError < 0) || (bError >= bStep);
+        }
+    }
+
+    // 6) The last packet truncated, or with a width above ECG_BR_PACKED_BITS,
+    //    must be rejected
+    nAdaptiveMismatch += !ECGBitReduction_UnpackAdaptive(pbAdaptive, nBytes - 1, nPacked, pbDecoded);
+    pbAdaptive[MAX_ECG - 1] |= 0xF0;
+    nAdaptiveMismatch += !ECGBitReduction_UnpackAdaptive(pbAdaptive, sizeof(pbAdaptive), nPacked, pbDecoded);
+
+    printf("%zu adaptive samples differ beyond the exponent, %zu/%zu clipped by the fixed mode differ from the filter, %.1f bytes per %d samples\r\n",
+           nAdaptiveMismatch, nClippedMismatch, nClipped, (double)nAdaptiveBytes * BENCH_PACKET_SAMPLES / (double)nSamples,
+           BENCH_PACKET_SAMPLES * MAX_ECG);
+
+    // 7) Cost per sample
+    printf("%-7s %6.1f ns/sample\r\n", tReference.pName, bench_time(&tReference, pSamples, nSamples));
+    printf("%-7s %6.1f ns/sample\r\n", tInteger.pName, bench_time(&tInteger, pSamples, nSamples));
+    printf("%-7s %6.1f ns/sample\r\n", "packet", bench_time_packet(pSamples, nSamples, pPacket));
+
+    free(pSamples);
+    free(pSingle);
+    free(pPacket);
+    free(pdUnclamped);
+
+    return ((bMaxDiff <= BENCH_MAX_DIFF) && (nMismatch * BENCH_MAX_MISMATCH <= nSamples * MAX_ECG) && (nPacketMismatch == 0) && (nPackMismatch == 0) && (nAdaptiveMismatch == 0) && (nClippedMismatch == 0)) ? 0 : 1;
+}
@@ -2,9 +2,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
-#include <math.h>
 #include "ecg_bit_reduction.h"
-#include "data_processing.h"
 
 // --- Defines and macros ---
 
@@ -12,67 +10,80 @@
 #define BR_THRESHOLD_AMP_SETTLING       100
 #define BR_THRESHOLD_MEAN_DIFF          233333          // 20mv
 #define BR_THRESHOLD_SUCCESSIVE_DIFF    11666           // 1mv
-#define BR_MEAN_SAMPLE_COUNT_RES        0.0009765625l   // 1/1024
+#define BR_MEAN_SAMPLE_COUNT_SHIFT      10              // 1/1024
 #define BR_SAMPLE_WINDOW                80              // SAMPLES
 #define BR_MSB_TO_REMOVE                5
 #define BR_LSB_TO_REMOVE                7
 
-/* 
+/*
  * MSB_THRSHOLD Formula   (12800000/2)/(2^MSB_TO_REMOVE)
  * 6400000/32
  * 20000 bit reduced threshold
  */
 #define BR_MSB_THRSHOLD                 200000
 
-/* 
- * LSB_FACTOR   (2^LSB_TO_REMOVE)
- * 2^7 = 128
+// The bit reduced range, +-BR_MSB_THRSHOLD >> BR_LSB_TO_REMOVE, must fit the packed samples
+#if ((BR_MSB_THRSHOLD >> BR_LSB_TO_REMOVE) >= (1 << (ECG_BR_PACKED_BITS - 1)))
+#error "Bit reduced samples do not fit in ECG_BR_PACKED_BITS"
+#endif
+
+/*
+ * Fixed point formats
+ * HP_COEFF_Q   filter coefficients are Q28, |a1| and |b1| are just under 2
+ * HP_OUTPUT_Q  filter output keeps 6 fractional bits, so LSB removal is a
+ *              single arithmetic shift by HP_OUTPUT_Q + BR_LSB_TO_REMOVE
  */
-#define BR_LSB_FACTOR                   128.0l
+#define HP_COEFF_Q                      28
+#define HP_OUTPUT_Q                     6
 
 // High Pass Filter definitions
-#define HP_FILTER_SIZE                  3
-#define HP_FILTER_COEFF_LEN_A           3
-#define HP_FILTER_COEFF_LEN_B           3
+#define HP_FILTER_SIZE                  2               // Past samples kept per channel
 
 // --- Globals ---
 
-static const double gflHighpassCoeffiecientsA[] = {1.0l,                 -1.9991669594972l,  0.9991673063310l};
-static const double gflHighpassCoeffiecientsB[] = {0.99958356645707l,    -1.99916713291414l, 0.99958356645705l};
-static double gflHighpassInput[MAX_ECG][HP_FILTER_SIZE] = {0};
-static double gflHighpassOutput[MAX_ECG][HP_FILTER_SIZE] = {0};
-
-static double gflMeanValue[MAX_ECG] = {0};
+/*
+ * HP filter {1, -1.9991669594972, 0.9991673063310} / {0.99958356645707,
+ * -1.99916713291414, 0.99958356645705} in Q28. The feedforward taps are
+ * b0 * {1, -2, 1} so the DC rejection stays exact after quantization. b0
+ * multiplies raw inputs, so it is kept in Q34 (Q28 value 268323670 << 6)
+ * to land in the accumulator format without shifting a signed product.
+ */
+static const int64_t gbHighpassCoeffiecientB0 = 17172714880LL;
+static const int32_t gbHighpassCoeffiecientA1 = -536647294;
+static const int32_t gbHighpassCoeffiecientA2 = 268211931;
+// Channel state is stored as structure of arrays, indexed [tap][channel]
+static int32_t gbHighpassInput[HP_FILTER_SIZE][MAX_ECG] = {0};   // Raw samples
+static int32_t gbHighpassOutput[HP_FILTER_SIZE][MAX_ECG] = {0};  // Q6 outputs
+static int32_t gbHighpassError[HP_FILTER_SIZE][MAX_ECG] = {0};   // Q34 rounding errors
+
+static int64_t gbMeanValue[MAX_ECG] = {0};                      // Q10 mean
 static uint32_t gbPreviousECG[MAX_ECG] = {0};
 static bool gfLastHighAmplitudeFlag[MAX_ECG] = {0};
 static uint8_t gbSampleCount[MAX_ECG] = {0};
 
-static bool gfResetFlagECG[MAX_ECG] = {false, false, false};
+static bool gfRestartPending[MAX_ECG] = {true, true, true};     // Set by ECGBitReduction_Restart
 
 
 // --- Functions ---
 
-static bool ECGBitReduction_CheckRestartFilter(uint32_t bRawSample, ecg_sens_id nECGId, bool fRestart)
+// The static functions take a channel index checked by the public functions
+
+static bool ECGBitReduction_CheckRestartFilter(uint32_t bRawSample, uint8_t nECGId, bool fRestart)
 {
     int32_t bSuccesiveDifference = 0;
-
-    // Check arguments
-    if (nECGId >= MAX_ECG)
-    {
-        return false;
-    }
+    int64_t bMeanDifference = 0;
 
     if (fRestart)
     {
-        gflMeanValue[nECGId] = (double)bRawSample;
+        gbMeanValue[nECGId] = (int64_t)bRawSample << BR_MEAN_SAMPLE_COUNT_SHIFT;
         gbPreviousECG[nECGId] = bRawSample;
         gfLastHighAmplitudeFlag[nECGId] = 0;
         gbSampleCount[nECGId] = 0;
         return true;
     }
 
-    // Calculate mean
-    gflMeanValue[nECGId] =  ((1.0 - BR_MEAN_SAMPLE_COUNT_RES) * gflMeanValue[nECGId] + (BR_MEAN_SAMPLE_COUNT_RES) * (double)bRawSample);
+    // Calculate mean, mean += (sample - mean) / 1024 in Q10
+    gbMeanValue[nECGId] += (int64_t)bRawSample - (gbMeanValue[nECGId] >> BR_MEAN_SAMPLE_COUNT_SHIFT);
 
     // Calculate difference of successive samples
     bSuccesiveDifference = bRawSample - gbPreviousECG[nECGId];
@@ -86,7 +97,9 @@ static bool ECGBitReduction_CheckRestartFilter(uint32_t bRawSample, ecg_sens_id
      * 2. Check if successive difference between two samples
      * is greater than BR_THRESHOLD_SUCCESSIVE_DIFF
      */
-    if ((abs(bRawSample - gflMeanValue[nECGId]) > BR_THRESHOLD_MEAN_DIFF) && (bSuccesiveDifference > BR_THRESHOLD_SUCCESSIVE_DIFF))
+    bMeanDifference = ((int64_t)bRawSample << BR_MEAN_SAMPLE_COUNT_SHIFT) - gbMeanValue[nECGId];
+    bMeanDifference = (bMeanDifference < 0) ? -bMeanDifference : bMeanDifference;
+    if ((bMeanDifference > ((int64_t)BR_THRESHOLD_MEAN_DIFF << BR_MEAN_SAMPLE_COUNT_SHIFT)) && (bSuccesiveDifference > BR_THRESHOLD_SUCCESSIVE_DIFF))
     {
         gfLastHighAmplitudeFlag[nECGId] = 1;
         gbSampleCount[nECGId] = 0;
@@ -113,58 +126,394 @@ static bool ECGBitReduction_CheckRestartFilter(uint32_t bRawSample, ecg_sens_id
     return false;
 }
 
-static int16_t ECGBitReduction_LSBRemoval(double bSample)
+/*
+ * @brief  This function high pass filters a raw sample in fixed point.
+ * @param  bSample - raw ADC sample
+ * @param  nECGId - channel whose filter state is used
+ * @param  fReset - restart the filter from this sample, zero output
+ * @detail Direct form I in a 64 bit accumulator, Q28 coefficients times raw
+ *         inputs and Q6 outputs give a Q34 sum. The poles sit next to z = 1
+ *         (DC gain of the feedback about 2.9e6), so the Q34 -> Q6 rounding
+ *         error is fed back through (1 - z^-1)^2 to cancel that gain;
+ *         without it the output drifts by hundreds of LSBs from the double
+ *         filter.
+ * @retval filtered sample in Q6
+ */
+static inline int32_t ECGBitReduction_HighpassFilter(uint32_t bSample, uint8_t nECGId, bool fReset)
+{
+    int64_t bAccumulator = 0;
+    int64_t bOutput = 0;
+
+    // 1) If fReset was set, start from the current sample with a zero output
+    if (fReset)
+    {
+        gbHighpassInput[0][nECGId] = gbHighpassInput[1][nECGId] = (int32_t)bSample;
+        gbHighpassOutput[0][nECGId] = gbHighpassOutput[1][nECGId] = 0;
+        gbHighpassError[0][nECGId] = gbHighpassError[1][nECGId] = 0;
+    }
+
+    // 2) Feedforward b0 * (x[n] - 2x[n-1] + x[n-2]), feedback and error feedback in Q34
+    bAccumulator  = gbHighpassCoeffiecientB0 * ((int64_t)bSample - 2 * (int64_t)gbHighpassInput[0][nECGId] + gbHighpassInput[1][nECGId]);
+    bAccumulator -= (int64_t)gbHighpassCoeffiecientA1 * gbHighpassOutput[0][nECGId];
+    bAccumulator -= (int64_t)gbHighpassCoeffiecientA2 * gbHighpassOutput[1][nECGId];
+    bAccumulator += 2 * (int64_t)gbHighpassError[0][nECGId] - gbHighpassError[1][nECGId];
+
+    // 3) Back to Q6, keeping the rounding error
+    bOutput = bAccumulator >> HP_COEFF_Q;
+    gbHighpassError[1][nECGId] = gbHighpassError[0][nECGId];
+    gbHighpassError[0][nECGId] = (int32_t)(bAccumulator - bOutput * ((int64_t)1 << HP_COEFF_Q));
+
+    // 4) Shift the past samples, saturating the output state to 32 bits
+    bOutput = (bOutput > INT32_MAX) ? INT32_MAX : (bOutput < INT32_MIN) ? INT32_MIN : bOutput;
+    gbHighpassInput[1][nECGId] = gbHighpassInput[0][nECGId];
+    gbHighpassInput[0][nECGId] = (int32_t)bSample;
+    gbHighpassOutput[1][nECGId] = gbHighpassOutput[0][nECGId];
+    gbHighpassOutput[0][nECGId] = (int32_t)bOutput;
+
+    return (int32_t)bOutput;
+}
+
+static inline int16_t ECGBitReduction_LSBRemoval(int32_t bSample)
+{
+    //remove lsb and return, the arithmetic shift floors like the division did
+    return (int16_t)(bSample >> (HP_OUTPUT_Q + BR_LSB_TO_REMOVE));
+}
+
+static inline int32_t ECGBitReduction_MSBRemoval(int32_t bSample)
+{
+    // Remove msb
+    if (bSample >= (BR_MSB_THRSHOLD << HP_OUTPUT_Q))
+    {
+        return BR_MSB_THRSHOLD << HP_OUTPUT_Q;
+    }
+
+    if (bSample <= -(BR_MSB_THRSHOLD << HP_OUTPUT_Q))
+    {
+        return -(BR_MSB_THRSHOLD << HP_OUTPUT_Q);
+    }
+
+    return bSample;
+}
+
+static inline int32_t ECGBitReduction_FilterChannel(uint32_t bSample, uint8_t nECGId, bool fRestart)
 {
-    double flProcessedLSB = 0;
+    bool fReset = false;
 
-    //remove lsb and return
-    flProcessedLSB = (double)(bSample) / BR_LSB_FACTOR;
+    // 1) Check restart, including one requested by ECGBitReduction_Restart
+    fReset = ECGBitReduction_CheckRestartFilter(bSample, nECGId, fRestart || gfRestartPending[nECGId]);
+    gfRestartPending[nECGId] = false;
 
-    return (int16_t)(floor(flProcessedLSB));
+    // 2) Filter data
+    return ECGBitReduction_HighpassFilter(bSample, nECGId, fReset);
 }
 
-static double ECGBitReduction_MSBRemoval(uint32_t bSample, ecg_sens_id nECGId, bool fRestart)
+static inline int16_t ECGBitReduction_ReduceChannel(uint32_t bSample, uint8_t nECGId, bool fRestart)
 {
-    double flProcessedMSB = 0;
+    // Filter data, remove MSB and LSB
+    return ECGBitReduction_LSBRemoval(ECGBitReduction_MSBRemoval(ECGBitReduction_FilterChannel(bSample, nECGId, fRestart)));
+}
 
+/*
+ * @brief  This function bit reduces one sample of one ECG channel.
+ * @param  bSample - raw ADC sample
+ * @param  nECGId - channel of the sample
+ * @param  fRestart - restart the filter of the channel from this sample
+ * @detail The first sample of a channel, and the first one after
+ *         ECGBitReduction_Restart, restarts its filter even if fRestart is
+ *         false.
+ * @retval bit reduced sample, 0 for an invalid channel
+ */
+int16_t ECGBitReduction_SampleReduction(uint32_t bSample, ecg_sens_id nECGId, bool fRestart)
+{
     // Check arguments
     if (nECGId >= MAX_ECG)
     {
         return 0;
     }
 
-    // Check_restart
-    gfResetFlagECG[nECGId] = ECGBitReduction_CheckRestartFilter(bSample, nECGId, fRestart);
+    return ECGBitReduction_ReduceChannel(bSample, (uint8_t)nECGId, fRestart);
+}
 
-    // Filter data - XXX remove ecgbr_digital_filter() and replace with standard float-based digital_filter function
-    flProcessedMSB = ecgbr_digital_filter((double)bSample, gflHighpassInput[nECGId], gflHighpassOutput[nECGId], gflHighpassCoeffiecientsA, gflHighpassCoeffiecientsB, 
-        HP_FILTER_COEFF_LEN_A, HP_FILTER_COEFF_LEN_B, HP_FILTER_SIZE, gfResetFlagECG[nECGId], (double)bSample);
-    
-    // Reset flt flag
-    gfResetFlagECG[nECGId] = false;
-    
-    // Remove msb
-    if ((flProcessedMSB >= BR_MSB_THRSHOLD) || (flProcessedMSB <= -1 * BR_MSB_THRSHOLD))
+/*
+ * @brief  This function bit reduces a packet of all ECG channels.
+ * @param  pInterleaved - raw ADC samples, ECG1, ECG2, ECG3 for each sample
+ * @param  nSamples - samples per channel, pInterleaved holds nSamples * MAX_ECG
+ * @param  pOut - bit reduced samples, same layout as pInterleaved
+ * @detail Arguments are checked once per packet instead of per sample and
+ *         channel. Call ECGBitReduction_Restart to restart the filters on the
+ *         next packet.
+ * @retval true on error
+ */
+bool ECGBitReduction_ReducePacket(const uint32_t *pInterleaved, size_t nSamples, int16_t *pOut)
+{
+    // 1) Check arguments
+    if ((pInterleaved == NULL) || (pOut == NULL))
+    {
+        return true;
+    }
+
+    // 2) Reduce every channel of every sample
+    for (size_t i = 0; i < nSamples; i++)
     {
-        flProcessedMSB = (int32_t)(BR_MSB_THRSHOLD) * (flProcessedMSB / (int32_t)abs(flProcessedMSB));
+        for (uint8_t ch = 0; ch < MAX_ECG; ch++)
+        {
+            pOut[ch] = ECGBitReduction_ReduceChannel(pInterleaved[ch], ch, false);
+        }
+        pInterleaved += MAX_ECG;
+        pOut += MAX_ECG;
     }
 
-    return flProcessedMSB;
+    return false;
 }
 
-int16_t ECGBitReduction_SampleReduction(uint32_t bSample, ecg_sens_id nECGId, bool fRestart)
+/*
+ * @brief  This function restarts the filters of all channels on their next
+ *         sample, they also restart on the very first sample.
+ * @retval no return type
+ */
+void ECGBitReduction_Restart(void)
+{
+    for (uint8_t ch = 0; ch < MAX_ECG; ch++)
+    {
+        gfRestartPending[ch] = true;
+    }
+
+    return;
+}
+
+/*
+ * @brief  This function packs bit reduced samples at ECG_BR_PACKED_BITS.
+ * @param  pSamples - bit reduced samples, any channel layout
+ * @param  nSamples - number of samples
+ * @param  pPacked - ECG_BR_PACKED_SIZE(nSamples) bytes
+ * @detail Samples are stored little endian, two samples in 3 bytes:
+ *         s0[7:0], s1[3:0] s0[11:8], s1[11:4]. An odd last sample takes
+ *         2 bytes with the upper 4 bits zero.
+ * @retval true on error
+ */
+bool ECGBitReduction_Pack(const int16_t *pSamples, size_t nSamples, uint8_t *pPacked)
 {
-    double flProcessedMSB = 0;
+    uint16_t bFirst = 0;
+    uint16_t bSecond = 0;
+    size_t i = 0;
 
-    // Check arguments
-    if (nECGId >= MAX_ECG)
+    // 1) Check arguments
+    if ((pSamples == NULL) || (pPacked == NULL))
     {
-        return 0;
+        return true;
+    }
+
+    // 2) Pairs of samples in 3 bytes
+    for (i = 0; i + 1 < nSamples; i += 2)
+    {
+        bFirst  = (uint16_t)pSamples[i] & 0x0FFF;
+        bSecond = (uint16_t)pSamples[i + 1] & 0x0FFF;
+        pPacked[0] = (uint8_t)bFirst;
+        pPacked[1] = (uint8_t)((bFirst >> 8) | (bSecond << 4));
+        pPacked[2] = (uint8_t)(bSecond >> 4);
+        pPacked += 3;
+    }
+
+    // 3) Odd last sample
+    if (i < nSamples)
+    {
+        bFirst = (uint16_t)pSamples[i] & 0x0FFF;
+        pPacked[0] = (uint8_t)bFirst;
+        pPacked[1] = (uint8_t)(bFirst >> 8);
     }
 
-    // Remove MSB
-    flProcessedMSB = ECGBitReduction_MSBRemoval(bSample, nECGId, fRestart);
+    return false;
+}
+
+/*
+ * @brief  This function unpacks samples written by ECGBitReduction_Pack.
+ * @param  pPacked - ECG_BR_PACKED_SIZE(nSamples) bytes
+ * @param  nSamples - number of samples
+ * @param  pSamples - sign extended bit reduced samples
+ * @retval true on error
+ */
+bool ECGBitReduction_Unpack(const uint8_t *pPacked, size_t nSamples, int16_t *pSamples)
+{
+    uint16_t bFirst = 0;
+    uint16_t bSecond = 0;
+    size_t i = 0;
+
+    // 1) Check arguments
+    if ((pPacked == NULL) || (pSamples == NULL))
+    {
+        return true;
+    }
+
+    // 2) Pairs of samples from 3 bytes, sign extended from bit 11
+    for (i = 0; i + 1 < nSamples; i += 2)
+    {
+        bFirst  = (uint16_t)(pPacked[0] | ((pPacked[1] & 0x0F) << 8));
+        bSecond = (uint16_t)((pPacked[1] >> 4) | (pPacked[2] << 4));
+        pSamples[i]     = (int16_t)((int16_t)(bFirst << 4) >> 4);
+        pSamples[i + 1] = (int16_t)((int16_t)(bSecond << 4) >> 4);
+        pPacked += 3;
+    }
+
+    // 3) Odd last sample
+    if (i < nSamples)
+    {
+        bFirst = (uint16_t)(pPacked[0] | ((pPacked[1] & 0x0F) << 8));
+        pSamples[i] = (int16_t)((int16_t)(bFirst << 4) >> 4);
+    }
+
+    return false;
+}
+
+static uint8_t ECGBitReduction_SignedWidth(int32_t bValue)
+{
+    uint32_t bMagnitude = (bValue < 0) ? ~(uint32_t)bValue : (uint32_t)bValue;
+    uint8_t bWidth = 1;
+
+    // Sign bit plus the significant bits of the magnitude
+    while (bMagnitude != 0)
+    {
+        bMagnitude >>= 1;
+        bWidth++;
+    }
+
+    return bWidth;
+}
+
+/*
+ * @brief  This function bit reduces a packet of all ECG channels with a
+ *         shift chosen per packet and channel (block floating point).
+ * @param  pInterleaved - raw ADC samples, ECG1, ECG2, ECG3 for each sample
+ * @param  nSamples - samples per channel, at most ECG_BR_ADAPTIVE_MAX_SAMPLES
+ * @param  pPacked - ECG_BR_ADAPTIVE_SIZE(nSamples) bytes
+ * @param  pnPacked - bytes written to pPacked
+ * @detail The filter output is not clamped at BR_MSB_THRSHOLD. The LSBs are
+ *         removed as in the fixed mode, then the width is the bits the
+ *         packet range needs. Above ECG_BR_PACKED_BITS, more LSBs are removed
+ *         instead of clipping, so quiet packets take fewer bits and large
+ *         excursions lose resolution, not amplitude. Shares the filter state
+ *         with the fixed mode.
+ * @retval true on error
+ */
+bool ECGBitReduction_ReducePacketAdaptive(const uint32_t *pInterleaved, size_t nSamples, uint8_t *pPacked, size_t *pnPacked)
+{
+    int32_t pbFiltered[ECG_BR_ADAPTIVE_MAX_SAMPLES];    // Q6 filtered samples of one channel
+    uint8_t *pStart = pPacked;
+    int32_t bMax = 0;
+    int32_t bMin = 0;
+    uint8_t bWidth = 0;
+    uint8_t bShift = 0;
+    uint32_t bBits = 0;
+    uint8_t bBitCount = 0;
+
+    // 1) Check arguments
+    if ((pInterleaved == NULL) || (pPacked == NULL) || (pnPacked == NULL) || (nSamples > ECG_BR_ADAPTIVE_MAX_SAMPLES))
+    {
+        return true;
+    }
+
+    pPacked += MAX_ECG;
+    for (uint8_t ch = 0; ch < MAX_ECG; ch++)
+    {
+        // 2) Filter the packet of the channel, the channels are independent
+        bMax = bMin = 0;
+        for (size_t i = 0; i < nSamples; i++)
+        {
+            pbFiltered[i] = ECGBitReduction_FilterChannel(pInterleaved[i * MAX_ECG + ch], ch, false);
+            bMax = (pbFiltered[i] > bMax) ? pbFiltered[i] : bMax;
+            bMin = (pbFiltered[i] < bMin) ? pbFiltered[i] : bMin;
+        }
+
+        // 3) Width of the packet range with the fixed LSB removal, capped by
+        //    removing more LSBs
+        bShift = HP_OUTPUT_Q + BR_LSB_TO_REMOVE;
+        bWidth = ECGBitReduction_SignedWidth(bMax >> bShift);
+        bWidth = (ECGBitReduction_SignedWidth(bMin >> bShift) > bWidth) ? ECGBitReduction_SignedWidth(bMin >> bShift) : bWidth;
+        if (bWidth > ECG_BR_PACKED_BITS)
+        {
+            bShift += bWidth - ECG_BR_PACKED_BITS;
+            bWidth = ECG_BR_PACKED_BITS;
+        }
+        pStart[ch] = (uint8_t)(((bWidth - 1) << 4) | (bShift - HP_OUTPUT_Q - BR_LSB_TO_REMOVE));
+
+        // 4) Samples at bWidth bits, little endian
+        bBits = 0;
+        bBitCount = 0;
+        for (size_t i = 0; i < nSamples; i++)
+        {
+            bBits |= ((uint32_t)(pbFiltered[i] >> bShift) & ((1u << bWidth) - 1)) << bBitCount;
+            bBitCount += bWidth;
+            while (bBitCount >= 8)
+            {
+                *pPacked++ = (uint8_t)bBits;
+                bBits >>= 8;
+                bBitCount -= 8;
+            }
+        }
+        if (bBitCount > 0)
+        {
+            *pPacked++ = (uint8_t)bBits;
+        }
+    }
+
+    *pnPacked = (size_t)(pPacked - pStart);
+
+    return false;
+}
 
-    // Remove LSB
-    return ECGBitReduction_LSBRemoval(flProcessedMSB);
+/*
+ * @brief  This function unpacks a packet of ECGBitReduction_ReducePacketAdaptive.
+ * @param  pPacked - adaptive packet
+ * @param  nPacked - bytes received in pPacked
+ * @param  nSamples - samples per channel in the packet, at most
+ *         ECG_BR_ADAPTIVE_MAX_SAMPLES
+ * @param  pOut - nSamples * MAX_ECG interleaved samples in the LSBs of the
+ *         fixed mode, the exponent applied
+ * @detail The header comes from received data: a width above
+ *         ECG_BR_PACKED_BITS or a packet shorter than its header announces is
+ *         rejected, pOut is then partly written.
+ * @retval true on error
+ */
+bool ECGBitReduction_UnpackAdaptive(const uint8_t *pPacked, size_t nPacked, size_t nSamples, int32_t *pOut)
+{
+    const uint8_t *pHeader = pPacked;
+    const uint8_t *pEnd = pPacked + nPacked;
+    uint8_t bWidth = 0;
+    uint8_t bExponent = 0;
+    uint32_t bBits = 0;
+    uint8_t bBitCount = 0;
+
+    // 1) Check arguments
+    if ((pPacked == NULL) || (pOut == NULL) || (nSamples > ECG_BR_ADAPTIVE_MAX_SAMPLES) || (nPacked < MAX_ECG))
+    {
+        return true;
+    }
+
+    pPacked += MAX_ECG;
+    for (uint8_t ch = 0; ch < MAX_ECG; ch++)
+    {
+        // 2) Channel header, the width and the samples must fit the packet
+        bWidth = (uint8_t)((pHeader[ch] >> 4) + 1);
+        bExponent = pHeader[ch] & 0x0F;
+        if ((bWidth > ECG_BR_PACKED_BITS) || ((size_t)(pEnd - pPacked) < (nSamples * bWidth + 7) / 8))
+        {
+            return true;
+        }
+
+        // 3) Sign extend the samples from bWidth bits and apply the exponent
+        bBits = 0;
+        bBitCount = 0;
+        for (size_t i = 0; i < nSamples; i++)
+        {
+            while (bBitCount < bWidth)
+            {
+                bBits |= (uint32_t)(*pPacked++) << bBitCount;
+                bBitCount += 8;
+            }
+            pOut[i * MAX_ECG + ch] = ((int32_t)(bBits << (32 - bWidth)) >> (32 - bWidth)) * (1 << bExponent);
+            bBits >>= bWidth;
+            bBitCount -= bWidth;
+        }
+    }
+
+    return false;
 }
@@ -15,7 +15,26 @@ typedef enum
     MAX_ECG,
 } ecg_sens_id;
 
+// Bit reduced samples fit in 12 bits, two samples are packed in 3 bytes
+#define ECG_BR_PACKED_BITS              12
+#define ECG_BR_PACKED_SIZE(nSamples)    (((nSamples) * ECG_BR_PACKED_BITS + 7) / 8)
+
+/*
+ * Adaptive packets start with one header byte per channel, bits 7-4 the
+ * sample width - 1 and bits 3-0 the exponent, the shift beyond the fixed
+ * BR_LSB_TO_REMOVE. The samples of each channel follow at that width,
+ * little endian bit streams starting on a byte.
+ */
+#define ECG_BR_ADAPTIVE_MAX_SAMPLES     64
+#define ECG_BR_ADAPTIVE_SIZE(nSamples)  (MAX_ECG * (1 + ECG_BR_PACKED_SIZE(nSamples)))
+
 int16_t ECGBitReduction_SampleReduction(uint32_t bSample, ecg_sens_id nECGId, bool fRestart);
+bool ECGBitReduction_ReducePacket(const uint32_t *pInterleaved, size_t nSamples, int16_t *pOut);
+void ECGBitReduction_Restart(void);
+bool ECGBitReduction_Pack(const int16_t *pSamples, size_t nSamples, uint8_t *pPacked);
+bool ECGBitReduction_Unpack(const uint8_t *pPacked, size_t nSamples, int16_t *pSamples);
+bool ECGBitReduction_ReducePacketAdaptive(const uint32_t *pInterleaved, size_t nSamples, uint8_t *pPacked, size_t *pnPacked);
+bool ECGBitReduction_UnpackAdaptive(const uint8_t *pPacked, size_t nPacked, size_t nSamples, int32_t *pOut);
 
 
 #endif /* SRC_ALGORITHMS_ECG_BIT_REDUCTION_H_ */
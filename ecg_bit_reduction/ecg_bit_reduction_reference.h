@@ -0,0 +1,10 @@
+#ifndef SRC_ALGORITHMS_ECG_BIT_REDUCTION_REFERENCE_H_
+#define SRC_ALGORITHMS_ECG_BIT_REDUCTION_REFERENCE_H_
+
+#include "ecg_bit_reduction.h"
+
+// Double precision bit reduction, kept as the reference for br_bench.c
+int16_t ECGBitReductionRef_SampleReduction(uint32_t bSample, ecg_sens_id nECGId, bool fRestart);
+double ECGBitReductionRef_GetFilterOutput(ecg_sens_id nECGId);    // Before MSB removal, in ADC counts
+
+#endif /* SRC_ALGORITHMS_ECG_BIT_REDUCTION_REFERENCE_H_ */